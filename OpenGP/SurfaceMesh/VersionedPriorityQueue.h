@@ -0,0 +1,112 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <OpenGP/types.h>
+
+//=============================================================================
+namespace OpenGP{
+//=============================================================================
+
+/// @brief Min-priority queue of mesh elements with lazy deletion
+///
+/// Holds handles (SurfaceMesh::Vertex, Edge, Halfedge or Face: anything with an idx())
+/// in a binary heap. Every element carries a version (timestamp), bumped whenever it is
+/// pushed again, removed or popped; heap entries remember the version they were pushed
+/// with, so the outdated ones are simply skipped when they surface at the top. Updating
+/// the priority of an element is thus a plain O(log n) push, never a search or an erase.
+/// The heap is compacted once stale entries outnumber the live ones.
+/// Equal priorities pop in increasing element index (deterministic order).
+template <class Handle, class Priority = Scalar>
+class VersionedPriorityQueue{
+    struct Entry{
+        Priority priority;
+        Handle handle;
+        unsigned int version;
+        /// std::push_heap/pop_heap keep the "largest" entry on top: invert the order
+        bool operator<(const Entry& other) const{
+            return (priority == other.priority) ? (handle.idx() > other.handle.idx()) : (priority > other.priority);
+        }
+    };
+    std::vector<Entry> _heap;
+    std::vector<unsigned int> _version; ///< current version of each element
+    std::vector<char> _queued;          ///< does the element have a live entry?
+    size_t _size = 0;                   ///< number of live entries
+
+public:
+    /// Number of queued elements
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+    bool contains(Handle h) const { return (size_t) h.idx() < _queued.size() && _queued[h.idx()]; }
+
+    /// Inserts h or, if already queued, updates its priority
+    void push(Handle h, Priority priority){
+        size_t i = h.idx();
+        if(i >= _version.size()){
+            _version.resize(i + 1, 0);
+            _queued.resize(i + 1, 0);
+        }
+        if(!_queued[i]){ _queued[i] = 1; ++_size; }
+        _heap.push_back({priority, h, ++_version[i]});
+        std::push_heap(_heap.begin(), _heap.end());
+        compact();
+    }
+
+    /// Drops h, if queued (its entry is discarded once it reaches the top)
+    void remove(Handle h){
+        if(!contains(h)) return;
+        invalidate(h.idx());
+        compact();
+    }
+
+    /// Element with the smallest priority (the queue must not be empty)
+    Handle top(){ prune(); return _heap.front().handle; }
+    Priority top_priority(){ prune(); return _heap.front().priority; }
+
+    /// Removes and returns the element with the smallest priority (the queue must not be empty)
+    Handle pop(){
+        prune();
+        Handle h = _heap.front().handle;
+        std::pop_heap(_heap.begin(), _heap.end());
+        _heap.pop_back();
+        invalidate(h.idx());
+        return h;
+    }
+
+    void clear(){
+        _heap.clear();
+        _version.clear();
+        _queued.clear();
+        _size = 0;
+    }
+
+    void reserve(size_t n_elements){
+        _heap.reserve(n_elements);
+        _version.reserve(n_elements);
+        _queued.reserve(n_elements);
+    }
+
+private:
+    bool is_live(const Entry& e) const { return e.version == _version[e.handle.idx()]; }
+    void invalidate(size_t i){
+        ++_version[i];
+        _queued[i] = 0;
+        --_size;
+    }
+    /// discards the stale entries on top of the heap
+    void prune(){
+        while(!is_live(_heap.front())){
+            std::pop_heap(_heap.begin(), _heap.end());
+            _heap.pop_back();
+        }
+    }
+    /// rebuilds the heap from the live entries when mostly stale (amortized O(1) per entry)
+    void compact(){
+        if(_heap.size() < 2 * _size + 1024) return;
+        _heap.erase(std::remove_if(_heap.begin(), _heap.end(), [this](const Entry& e){ return !is_live(e); }), _heap.end());
+        std::make_heap(_heap.begin(), _heap.end());
+    }
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,68 @@
+#include "ImplicitHoppe.h"
+#include <vector>
+#include <algorithm>
+
+typedef SurfaceMesh::Vertex Vertex;
+
+Scalar ImplicitHoppe::eval_implicit_at(const Vec3& p) const{
+    if(n_neighbors == 1){
+        Vertex closest = accelerator.closest_vertex(p);
+        return (vpoints[closest] - p).dot(vnormals[closest]);
+    }
+    std::vector<int> indices(n_neighbors);
+    std::vector<Scalar> sq_distances(n_neighbors);
+    accelerator.kNN(p, n_neighbors, indices.data(), sq_distances.data());
+    return blend(p, indices.data(), sq_distances.data());
+}
+
+void ImplicitHoppe::eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const{
+    const int chunk_size = 256;
+    int n = points.cols();
+    int nchunks = (n + chunk_size - 1) / chunk_size;
+    values.resize(n);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int chunk = 0; chunk < nchunks; ++chunk){
+        std::vector<int> indices(n_neighbors);
+        std::vector<Scalar> sq_distances(n_neighbors);
+        int end = std::min(n, (chunk + 1) * chunk_size);
+        for(int i = chunk * chunk_size; i < end; ++i){
+            Vec3 p = points.col(i);
+            int found = 0;
+            if(i > chunk * chunk_size){
+                // The previous neighbors are n_neighbors candidates for p, so the farthest
+                // of them bounds the distance of the n_neighbors-th closest sample. The slack
+                // covers rounding; a bound that still misses falls back to the full search.
+                Scalar bound = 0;
+                for(int j = 0; j < n_neighbors; ++j)
+                    bound = std::max(bound, (vpoints[Vertex(indices[j])] - p).squaredNorm());
+                if(bound > 0)
+                    found = accelerator.kNN(p, n_neighbors, indices.data(), sq_distances.data(), bound * Scalar(1.0001));
+            }
+            if(found < n_neighbors)
+                accelerator.kNN(p, n_neighbors, indices.data(), sq_distances.data());
+            values(i) = blend(p, indices.data(), sq_distances.data());
+        }
+    }
+}
+
+Scalar ImplicitHoppe::blend(const Vec3& p, const int* indices, const Scalar* sq_distances) const{
+    Vertex closest(indices[0]);
+    Scalar closest_value = (vpoints[closest] - p).dot(vnormals[closest]);
+    if(n_neighbors == 1 || sq_distances[0] == 0)
+        return closest_value;
+
+    // Franke-Little weights ((R - d) / (R d))^2, R the distance of the last neighbor:
+    // they vanish as a sample enters or leaves the neighborhood
+    Scalar R = std::sqrt(sq_distances[n_neighbors - 1]);
+    Scalar value = 0, sum = 0;
+    for(int i = 0; i < n_neighbors - 1; ++i){
+        Scalar d = std::sqrt(sq_distances[i]);
+        Scalar w = (R - d) / (R * d);
+        w *= w;
+        Vertex v(indices[i]);
+        value += w * (vpoints[v] - p).dot(vnormals[v]);
+        sum += w;
+    }
+    return sum > 0 ? value / sum : closest_value;
+}
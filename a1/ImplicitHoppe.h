@@ -5,27 +5,33 @@
 
 using namespace OpenGP;
 
+/// Signed distance to the tangent plane of the closest sample [Hoppe '92], positive inside.
+/// With k > 1 the tangent-plane distances of the k closest samples are blended with
+/// inverse-distance weights that vanish at the (k+1)-th closest one: unlike the
+/// closest-plane distance, which jumps across the Voronoi cells of the samples, the
+/// blend is continuous and a coarser grid resolves it.
 class ImplicitHoppe{
     SurfaceMeshVerticesKDTree accelerator;
     SurfaceMesh::Vertex_property<Vec3> vpoints;
     SurfaceMesh::Vertex_property<Vec3> vnormals;
+    int n_neighbors; ///< queried per evaluation, 1 or k+1
     
 public:
-    ImplicitHoppe(SurfaceMesh& cloud) : accelerator(cloud){
+    ImplicitHoppe(SurfaceMesh& cloud, int k = 1) : accelerator(cloud, SurfaceMeshVerticesKDTree::IN_PLACE){
         vpoints = cloud.get_vertex_property<Vec3>("v:point");
         vnormals = cloud.get_vertex_property<Vec3>("v:normal");        
+        n_neighbors = std::min<int>(k > 1 ? k + 1 : 1, cloud.n_vertices());
     }
 
     /// Evaluates implicit function at position p
-    Scalar eval_implicit_at(const Vec3& p) const{
-        // TASK: compute closest point
-		SurfaceMesh::Vertex closest_idx = accelerator.closest_vertex(p);
+    Scalar eval_implicit_at(const Vec3& p) const;
 
-        // TASK: compute point-to-plane distance
-		Vec3 closest_point = vpoints[closest_idx];
-		Vec3 closest_normal = vnormals[closest_idx];
-	//	return p.squaredNorm() - std::pow(.99, 2);
-		return (closest_point - p).dot(closest_normal);
+    /// Evaluates at each column of "points", in chunks processed in parallel. Within a chunk
+    /// the neighbors of a query bound the search of the next one, consecutive columns should
+    /// thus be close (e.g. a walk through a grid, see GridSampler).
+    void eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const;
 
-    }
+private:
+    /// Point-to-plane distance, blended over the neighbors (sorted by distance) if several
+    Scalar blend(const Vec3& p, const int* indices, const Scalar* sq_distances) const;
 };
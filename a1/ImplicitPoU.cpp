@@ -0,0 +1,173 @@
+#include "ImplicitPoU.h"
+#include <numeric>
+#include <OpenGP/MLogger.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+
+void ImplicitPoU::subdivide(const Box3& box, const std::vector<int>& indices, int depth, std::vector<Box3>& leaves) const{
+    if(indices.empty())
+        return;
+    if((int) indices.size() <= points_per_cell || depth == 16){
+        leaves.push_back(box);
+        return;
+    }
+    Vec3 center = box.center();
+    std::vector<int> children[8];
+    for(int i : indices){
+        Vec3 p = vpoints[SurfaceMesh::Vertex(i)];
+        int child = (p.x() >= center.x() ? 4 : 0) | (p.y() >= center.y() ? 2 : 0) | (p.z() >= center.z() ? 1 : 0);
+        children[child].push_back(i);
+    }
+    for(int c = 0; c < 8; ++c){
+        Vec3 lo, hi;
+        for(int d = 0; d < 3; ++d){
+            bool upper = (c >> (2 - d)) & 1;
+            lo[d] = upper ? center[d] : box.min()[d];
+            hi[d] = upper ? box.max()[d] : center[d];
+        }
+        subdivide(Box3(lo, hi), children[c], depth + 1, leaves);
+    }
+}
+
+void ImplicitPoU::fit(){
+    mDebug() << "Start partition of unity fitting";
+    int n = cloud.n_vertices();
+    int min_pts = std::min(min_points, n);
+
+    // Octree leaves holding at most points_per_cell samples
+    Box3 bbox = OpenGP::bbox_scaled(OpenGP::bbox_cubified(OpenGP::bounding_box(cloud)), 1.01);
+    std::vector<int> all(n);
+    std::iota(all.begin(), all.end(), 0);
+    std::vector<Box3> leaves;
+    subdivide(bbox, all, 0, leaves);
+    int n_cells = leaves.size();
+
+    // Independent local fits, in parallel
+    cells_.resize(n_cells);
+    std::vector<Eigen::Matrix3Xd> local_centers(n_cells);
+    std::vector<Eigen::VectorXd> local_weights(n_cells);
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int, Scalar>> neighbors;
+        std::vector<int> knn_indices(min_pts);
+        std::vector<Scalar> knn_sq_distances(min_pts);
+
+        #pragma omp for schedule(dynamic)
+        for(int c = 0; c < n_cells; ++c){
+            Cell& cell = cells_[c];
+            cell.center = leaves[c].center();
+            cell.radius = overlap * leaves[c].diagonal().norm() / 2;
+
+            // samples in the ball, grown to at least min_points
+            accelerator.radius_search(cell.center, cell.radius, neighbors);
+            if((int) neighbors.size() < min_pts){
+                accelerator.kNN(cell.center, min_pts, knn_indices.data(), knn_sq_distances.data());
+                cell.radius = std::sqrt(knn_sq_distances.back()) * Scalar(1.01);
+                accelerator.radius_search(cell.center, cell.radius, neighbors);
+            }
+            int m = neighbors.size();
+
+            // on-surface constraints (0) and offsets along the normals (+eps), relative
+            // to the cell center; an offset is halved until its closest local sample is
+            // its own, so that it does not cross the surface
+            Eigen::Vector3d center = cell.center.cast<double>();
+            Eigen::Matrix3Xd centers(3, 2 * m);
+            Eigen::VectorXd values = Eigen::VectorXd::Zero(2 * m + 4);
+            for(int i = 0; i < m; ++i)
+                centers.col(i) = vpoints[SurfaceMesh::Vertex(neighbors[i].first)].cast<double>() - center;
+            for(int i = 0; i < m; ++i){
+                Eigen::Vector3d normal = vnormals[SurfaceMesh::Vertex(neighbors[i].first)].cast<double>();
+                double eps = 0.1 * cell.radius;
+                for(int attempt = 0; attempt < 8; ++attempt){
+                    Eigen::Vector3d q = centers.col(i) + eps * normal;
+                    double own = (q - centers.col(i)).squaredNorm();
+                    int j = 0;
+                    while(j < m && (j == i || (q - centers.col(j)).squaredNorm() >= own)) ++j;
+                    if(j == m) break;
+                    eps /= 2;
+                }
+                centers.col(m + i) = centers.col(i) + eps * normal;
+                values(m + i) = eps;
+            }
+
+            // r^3 + linear polynomial, small dense system
+            int N = 2 * m;
+            Eigen::MatrixXd A = Eigen::MatrixXd::Zero(N + 4, N + 4);
+            for(int j = 0; j < N; ++j){
+                for(int i = 0; i < N; ++i){
+                    double r = (centers.col(i) - centers.col(j)).norm();
+                    A(i, j) = r*r*r;
+                }
+                A(j, N) = A(N, j) = 1;
+                A.block(j, N + 1, 1, 3) = centers.col(j).transpose();
+                A.block(N + 1, j, 3, 1) = centers.col(j);
+            }
+            Eigen::VectorXd x = A.partialPivLu().solve(values);
+            local_centers[c] = centers;
+            local_weights[c] = x.head(N);
+            cell.polynomial = x.tail(4);
+        }
+    }
+
+    // Flat storage
+    int total = 0;
+    for(int c = 0; c < n_cells; ++c){
+        cells_[c].begin = total;
+        total += local_centers[c].cols();
+        cells_[c].end = total;
+    }
+    centers_.resize(3, total);
+    weights_.resize(total);
+    max_radius_ = 0;
+    for(int c = 0; c < n_cells; ++c){
+        centers_.middleCols(cells_[c].begin, local_centers[c].cols()) = local_centers[c];
+        weights_.segment(cells_[c].begin, local_weights[c].size()) = local_weights[c];
+        max_radius_ = std::max(max_radius_, cells_[c].radius);
+    }
+
+    // Index the cells for the blending
+    cells_tree_.reset();
+    cell_centers_.clear();
+    for(const Cell& cell : cells_)
+        cell_centers_.add_vertex(cell.center);
+    cells_tree_.reset(new SurfaceMeshVerticesKDTree(cell_centers_, SurfaceMeshVerticesKDTree::IN_PLACE));
+    mDebug("Partition of unity: %d cells, %d centers", n_cells, total);
+}
+
+double ImplicitPoU::eval_cell(const Cell& cell, const Vec3& p) const{
+    Eigen::Vector3d q = (p - cell.center).cast<double>();
+    double value = cell.polynomial(0) + cell.polynomial.tail<3>().dot(q);
+    for(int j = cell.begin; j < cell.end; ++j){
+        double r = (q - centers_.col(j)).norm();
+        value += weights_(j) * r*r*r;
+    }
+    return value;
+}
+
+Scalar ImplicitPoU::eval_implicit_at(const Vec3& p) const{
+    // blend the fits of the balls containing p, with Wendland weights (1-r)^4 (4r+1)
+    std::vector<std::pair<int, Scalar>> near;
+    cells_tree_->radius_search(p, max_radius_, near);
+    double value = 0, weight = 0;
+    for(const auto& candidate : near){
+        const Cell& cell = cells_[candidate.first];
+        double r = std::sqrt(candidate.second) / cell.radius;
+        if(r >= 1) continue;
+        double s = 1 - r;
+        double w = s*s*s*s * (4*r + 1);
+        value += w * eval_cell(cell, p);
+        weight += w;
+    }
+    if(weight > 0)
+        return Scalar(value / weight);
+
+    // not covered (away from the samples): signed distance to the closest tangent plane
+    SurfaceMesh::Vertex closest = accelerator.closest_vertex(p);
+    return (p - vpoints[closest]).dot(vnormals[closest]);
+}
+
+void ImplicitPoU::eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const{
+    values.resize(points.cols());
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(int i = 0; i < (int) points.cols(); ++i)
+        values(i) = eval_implicit_at(Vec3(points.col(i)));
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <memory>
+#include <OpenGP/types.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include "SurfaceMeshVerticesKDTree.h"
+
+using namespace OpenGP;
+
+/// @brief Partition of unity of local RBF fits
+/// The bounding box is split (octree) into cells of at most "points_per_cell"
+/// samples. Every occupied cell is covered by a ball, "overlap" times its
+/// half-diagonal (grown until it holds "min_points" samples), on which a small
+/// independent r^3 RBF is fitted to the samples and their normal offsets; the
+/// local systems are solved in parallel. Evaluation blends the local fits with
+/// Wendland weights of the balls containing the query. Positive outside.
+class ImplicitPoU{
+public:
+    int points_per_cell = 48;
+    int min_points = 16;
+    Scalar overlap = 1.2;
+
+private:
+    struct Cell{
+        Vec3 center;
+        Scalar radius;
+        int begin, end;             ///< range of the local centers in centers_/weights_
+        Eigen::Vector4d polynomial; ///< c0 + c.(x - center)
+    };
+    SurfaceMesh& cloud;
+    SurfaceMesh::Vertex_property<Vec3> vpoints;
+    SurfaceMesh::Vertex_property<Vec3> vnormals;
+    SurfaceMeshVerticesKDTree accelerator;      ///< indexes the cloud
+    std::vector<Cell> cells_;
+    Eigen::Matrix3Xd centers_;                  ///< local centers, relative to their cell center
+    Eigen::VectorXd weights_;
+    Scalar max_radius_ = 0;
+    SurfaceMesh cell_centers_;                  ///< cells_ centers, as vertices
+    std::unique_ptr<SurfaceMeshVerticesKDTree> cells_tree_;
+
+public:
+    ImplicitPoU(SurfaceMesh& cloud) : cloud(cloud), accelerator(cloud, SurfaceMeshVerticesKDTree::IN_PLACE){
+        vpoints = cloud.get_vertex_property<Vec3>("v:point");
+        vnormals = cloud.get_vertex_property<Vec3>("v:normal");
+        fit();
+    }
+
+    /// Evaluates the blended implicit function at position p
+    Scalar eval_implicit_at(const Vec3& p) const;
+    /// Evaluates at each column of "points" (in parallel)
+    void eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const;
+
+    /// (Re)builds the cells and fits the local RBFs, e.g. after changing the parameters
+    void fit();
+
+private:
+    void subdivide(const Box3& box, const std::vector<int>& indices, int depth, std::vector<Box3>& leaves) const;
+    double eval_cell(const Cell& cell, const Vec3& p) const;
+};
@@ -1,6 +1,8 @@
 #include "ImplicitRBF.h"
 #include <OpenGP/MLogger.h>
-#include <OpenGP/SurfaceMesh/Eigen.h>
+#include <OpenGP/SurfaceMesh/eigen.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+#include <Eigen/Sparse>
 
 // A small number for determining the normal offset distance relative to the bounding box diameter
 #define OFFSET_EPSILON_R 0.001
@@ -12,29 +14,291 @@ void solve_linear_system(const MatMxN& A, const VecN& b, VecN& x){
     x = qr.solve(b);
 }
 
+/// Restarted GMRES(m) for Ax=b with right preconditioning (A P^-1 y = b, x = P^-1 y),
+/// A and P^-1 are given as functions; returns the number of iterations
+template <class MatVec, class Preconditioner>
+int gmres(const MatVec& A, const Preconditioner& P_inv, const Eigen::VectorXd& b, Eigen::VectorXd& x,
+          double tolerance, int restart, int max_iterations){
+    int n = b.size();
+    double threshold = tolerance * b.norm();
+    Eigen::MatrixXd V(n, restart + 1);
+    Eigen::MatrixXd H = Eigen::MatrixXd::Zero(restart + 1, restart);
+    Eigen::VectorXd cs(restart), sn(restart), g(restart + 1);
+
+    int iterations = 0;
+    while(iterations < max_iterations){
+        Eigen::VectorXd r = b - A(x);
+        double beta = r.norm();
+        if(beta <= threshold) break;
+        V.col(0) = r / beta;
+        g.setZero();
+        g(0) = beta;
+
+        int j = 0;
+        bool converged = false;
+        while(j < restart && iterations < max_iterations && !converged){
+            // Arnoldi (modified Gram-Schmidt)
+            Eigen::VectorXd w = A(P_inv(V.col(j)));
+            for(int i = 0; i <= j; ++i){
+                H(i, j) = w.dot(V.col(i));
+                w -= H(i, j) * V.col(i);
+            }
+            H(j + 1, j) = w.norm();
+            bool breakdown = H(j + 1, j) == 0; ///< exact solution in the Krylov space
+            if(!breakdown) V.col(j + 1) = w / H(j + 1, j);
+
+            // Givens rotations keep H upper triangular
+            for(int i = 0; i < j; ++i){
+                double t = cs(i) * H(i, j) + sn(i) * H(i + 1, j);
+                H(i + 1, j) = -sn(i) * H(i, j) + cs(i) * H(i + 1, j);
+                H(i, j) = t;
+            }
+            double d = std::hypot(H(j, j), H(j + 1, j));
+            cs(j) = H(j, j) / d;
+            sn(j) = H(j + 1, j) / d;
+            H(j, j) = d;
+            H(j + 1, j) = 0;
+            g(j + 1) = -sn(j) * g(j);
+            g(j) = cs(j) * g(j);
+
+            ++j;
+            ++iterations;
+            converged = std::fabs(g(j)) <= threshold || breakdown;
+        }
+        Eigen::VectorXd y = H.topLeftCorner(j, j).triangularView<Eigen::Upper>().solve(g.head(j));
+        x += P_inv(V.leftCols(j) * y);
+        if(converged) break;
+    }
+    return iterations;
+}
+
 void ImplicitRBF::optimize_rbf_weights(){
     mDebug() << "Start Implicit RBF fitting";
     int n = cloud.n_vertices();
-    int N = 2 * n;
+    Box3 bbox = OpenGP::bounding_box(cloud);
+    Scalar epsilon = OFFSET_EPSILON_R * bbox.diagonal().norm();
 
-    // Matrices for the RBF centers and their weights
+    // On-surface constraints (value 0) at the samples, off-surface ones (value +/-epsilon)
+    // along the normals; COMPACT also constrains the inside, as far from the samples
+    // there is no global kernel to propagate the sign
+    int n_offsets = (mode_ == COMPACT) ? 2 : 1;
+    int N = (1 + n_offsets) * n;
     centers_.setZero(3, N);
     weights_.setZero(N);
+    VecN d(N);
+    for(int i = 0; i < n; ++i){
+        SurfaceMesh::Vertex v(i);
+        Vec3 p = vpoints[v];
+        Vec3 normal = vnormals[v];
+        centers_.col(i) = p;
+        d(i) = 0;
+        centers_.col(n + i) = p + epsilon * normal;
+        d(n + i) = epsilon;
+        if(n_offsets == 2){
+            centers_.col(2 * n + i) = p - epsilon * normal;
+            d(2 * n + i) = -epsilon;
+        }
+    }
 
-    // Linear system matrix and right-hand-side vector for computing the weights
+    if(mode_ == COMPACT){
+        optimize_compact_rbf_weights(d);
+        return;
+    }
+    if(mode_ == TREECODE){
+        optimize_treecode_rbf_weights(d);
+        return;
+    }
+
+    // Linear system matrix for computing the weights
     MatMxN M(N, N);
-    VecN d(N);
+    #pragma omp parallel for schedule(static)
+    for(int j = 0; j < N; ++j)
+        for(int i = 0; i < N; ++i)
+            M(i, j) = kernel(centers_.col(j), centers_.col(i));
+    solve_linear_system(M, d, weights_);
+}
+
+void ImplicitRBF::optimize_compact_rbf_weights(const VecN& d){
+    int N = centers_.cols();
+    if(N == 0){
+        mWarning() << "Compact RBF: empty point cloud";
+        return;
+    }
+    cloud_tree_.reset(new SurfaceMeshVerticesKDTree(cloud, SurfaceMeshVerticesKDTree::IN_PLACE));
+
+    if(support_ <= 0){
+        // twice the average distance to the 8th nearest sample
+        const int k = std::min(8, (int) cloud.n_vertices() - 1);
+        if(k > 0){
+            IndicesMatrix indices;
+            MatMxN sq_distances;
+            cloud_tree_->kNNs(vertices_matrix(cloud), k + 1, indices, sq_distances);
+            support_ = 2 * sq_distances.row(k).cwiseSqrt().mean();
+        }
+        // a single sample, or coincident ones: fall back to the extent of the centers
+        if(!(support_ > 0) || !std::isfinite(support_)){
+            Vec3 extent = centers_.rowwise().maxCoeff() - centers_.rowwise().minCoeff();
+            support_ = std::max(extent.norm(), Scalar(1e-6));
+            mWarning() << "Compact RBF: degenerate sampling, support set to" << support_;
+        }
+    }
+
+    // Index the centers, the system is assembled over their support neighborhoods
+    centers_cloud_.clear();
+    centers_cloud_.reserve(N, 0, 0);
+    for(int i = 0; i < N; ++i)
+        centers_cloud_.add_vertex(centers_.col(i));
+    centers_tree_.reset(new SurfaceMeshVerticesKDTree(centers_cloud_, SurfaceMeshVerticesKDTree::IN_PLACE));
+    Neighborhoods neighborhoods;
+    centers_tree_->radius_search(support_, neighborhoods);
 
-    // HOMEWORK TASK:
-    // 1) Determine the RBF centers, and store them into the columns of matrix centers_;
-    //    The offset distance should be determined according to the bounding box diaginal length.
-    // 2) Collect the on- and off-surface constraints, to set up the linear system matrix M
-    //    and the right-hand-side d.
-    // 3) Use the memeber function solve_linear_system(...) to solve the linear system
-    //    to obtain RBF weights, and store them in the data member weights_.
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(neighborhoods.indices.size());
+    for(int i = 0; i < N; ++i){
+        const int* neighbors = neighborhoods.neighbors(i);
+        const Scalar* sq_distances = neighborhoods.sq_distances_of(i);
+        for(int j = 0; j < neighborhoods.n_neighbors(i); ++j)
+            triplets.push_back(Eigen::Triplet<double>(neighbors[j], i, compact_kernel(sq_distances[j])));
+    }
+    Eigen::SparseMatrix<double> M(N, N);
+    M.setFromTriplets(triplets.begin(), triplets.end());
+    mDebug("Compact RBF: %d centers, support %.4f, %d non-zeros", N, support_, (int) M.nonZeros());
+
+    // Symmetric positive definite (Wendland kernel): sparse Cholesky while its fill-in
+    // stays affordable, incomplete Cholesky preconditioned conjugate gradients beyond
+    Eigen::VectorXd w;
+    if(N <= 20000){
+        Eigen::SimplicialLDLT<Eigen::SparseMatrix<double>> solver(M);
+        w = solver.solve(d.cast<double>());
+        if(solver.info() != Eigen::Success)
+            mDebug() << "Compact RBF: factorization failed";
+    } else {
+        Eigen::ConjugateGradient<Eigen::SparseMatrix<double>, Eigen::Lower|Eigen::Upper,
+                                 Eigen::IncompleteCholesky<double>> solver(M);
+        solver.setTolerance(1e-6);
+        w = solver.solve(d.cast<double>());
+        mDebug("Compact RBF: CG %d iterations, error %.2e", (int) solver.iterations(), solver.error());
+    }
+    weights_ = w.cast<Scalar>();
+}
+
+void ImplicitRBF::optimize_treecode_rbf_weights(const VecN& d){
+    // r^3 is only conditionally positive definite: the interpolant is augmented by a
+    // linear polynomial, s(x) = sum_i w_i |x - c_i|^3 + c0 + c.x, with weights
+    // orthogonal to linear polynomials
+    //   [ A   P ] [w]   [d]
+    //   [ P^T 0 ] [c] = [0],   P = [1 x y z]
+    // A is only ever applied through the treecode.
+    int N = centers_.cols();
+    treecode_.reset(new RBFTreecode(centers_, 32, 0.3));
+    Eigen::MatrixXd P(N, 4);
+    P.col(0).setOnes();
+    P.rightCols(3) = centers_.transpose().cast<double>();
+    auto A = [&](const Eigen::VectorXd& x){
+        Eigen::VectorXd Ax(N + 4), Aw;
+        treecode_->set_weights(x.head(N));
+        treecode_->eval_at_centers(Aw);
+        Ax.head(N) = Aw + P * x.tail(4);
+        Ax.tail(4) = P.transpose() * x.head(N);
+        return Ax;
+    };
+
+    // The offset constraints nearly duplicate the on-surface ones (condition numbers
+    // of 1e8 and beyond for the default offset). Per sample, the pair of weights and
+    // the pair of equations are rewritten in terms of value and normal difference,
+    // i.e. a Hermite-like interpolation of values and normal derivatives:
+    //   w_on = y_on - y_off / eps,  w_off = y_off / eps            (right preconditioner)
+    //   r_on' = r_on,               r_off' = (r_off - r_on) / eps   (left)
+    int n = N / 2;
+    VecN eps = (centers_.rightCols(n) - centers_.leftCols(n)).colwise().norm().transpose();
+    auto right = [&](const Eigen::VectorXd& y){
+        Eigen::VectorXd w = y;
+        for(int i = 0; i < n; ++i){
+            w(n + i) = y(n + i) / eps(i);
+            w(i) = y(i) - w(n + i);
+        }
+        return w;
+    };
+    auto left = [&](const Eigen::VectorXd& r){
+        Eigen::VectorXd l = r;
+        for(int i = 0; i < n; ++i)
+            l(n + i) = (r(n + i) - r(i)) / eps(i);
+        return l;
+    };
+    auto LA = [&](const Eigen::VectorXd& x){ return left(A(x)); };
+
+    Eigen::VectorXd b = Eigen::VectorXd::Zero(N + 4);
+    b.head(N) = d.cast<double>();
+    b = left(b);
+    Eigen::VectorXd x = Eigen::VectorXd::Zero(N + 4);
+    int iterations = gmres(LA, right, b, x, 1e-6, 50, 1000);
+    double residual = (LA(x) - b).norm() / b.norm();
+    mDebug("Treecode RBF: %d centers, GMRES %d iterations, residual %.2e", N, iterations, residual);
+
+    weights_ = x.head(N).cast<Scalar>();
+    polynomial_ = x.tail(4);
+    treecode_->set_weights(x.head(N));
+}
+
+void ImplicitRBF::eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const{
+    if(mode_ == TREECODE){
+        Eigen::VectorXd v;
+        treecode_->eval(points, v);
+        v += points.transpose().cast<double>() * polynomial_.tail(3);
+        v.array() += polynomial_(0);
+        values = v.cast<Scalar>();
+        return;
+    }
+    values.resize(points.cols());
+    if(mode_ == DENSE){
+        #pragma omp parallel for schedule(dynamic, 256)
+        for(int i = 0; i < (int) points.cols(); ++i)
+            values(i) = eval_implicit_at(Vec3(points.col(i)));
+        return;
+    }
+    // COMPACT: one neighbor buffer per thread, rather than one per point
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int, Scalar>> neighbors;
+        #pragma omp for schedule(dynamic, 256)
+        for(int i = 0; i < (int) points.cols(); ++i)
+            values(i) = eval_compact_at(Vec3(points.col(i)), neighbors);
+    }
 }
 
 Scalar ImplicitRBF::eval_implicit_at(const Vec3& p) const{
-    // HOMEWORK TASK: evaluate the RBF implicit function at point "p"
-    return p.squaredNorm() - std::pow(.99,2);
+    if(mode_ == TREECODE){
+        Eigen::Vector3d q = p.cast<double>();
+        return (Scalar) (treecode_->eval(q) + polynomial_(0) + polynomial_.tail(3).dot(q));
+    }
+    if(mode_ == DENSE){
+        Scalar value = 0;
+        for(int i = 0; i < centers_.cols(); ++i)
+            value += weights_(i) * kernel(centers_.col(i), p);
+        return value;
+    }
+
+    std::vector<std::pair<int, Scalar>> neighbors;
+    return eval_compact_at(p, neighbors);
+}
+
+Scalar ImplicitRBF::eval_compact_at(const Vec3& p, std::vector<std::pair<int, Scalar>>& neighbors) const{
+    if(centers_.cols() == 0) return 0;
+
+    // Only the centers within the support contribute
+    centers_tree_->radius_search(p, support_, neighbors);
+    Scalar value = 0, coverage = 0;
+    for(const auto& neighbor : neighbors){
+        Scalar phi = compact_kernel(neighbor.second);
+        value += weights_(neighbor.first) * phi;
+        coverage += phi;
+    }
+    if(coverage >= 1)
+        return value;
+
+    // Towards the edge of the support the sum fades to zero; blend in the signed
+    // distance to the tangent plane of the closest sample to keep the sign
+    SurfaceMesh::Vertex closest = cloud_tree_->closest_vertex(p);
+    Scalar plane_distance = (p - vpoints[closest]).dot(vnormals[closest]);
+    return coverage * value + (1 - coverage) * plane_distance;
 }
@@ -1,19 +1,41 @@
 #pragma once
+#include <memory>
 #include <OpenGP/types.h>
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include "SurfaceMeshVerticesKDTree.h"
+#include "RBFTreecode.h"
 
 using namespace OpenGP;
 
 class ImplicitRBF{
+public:
+    /// DENSE: global triharmonic kernel r^3, dense QR solve (O(n^2) memory, O(n^3) time)
+    /// COMPACT: Wendland C2 kernel of compact support, the system is assembled over
+    ///          radius neighborhoods and solved by sparse Cholesky; evaluation only
+    ///          sums the centers within the support
+    /// TREECODE: the r^3 kernel of DENSE, but fitted by GMRES with hierarchical
+    ///          (far-field approximated) matrix-vector products, and evaluated with
+    ///          the same tree, O(n log n) per iteration instead of O(n^3)
+    enum Mode{ DENSE, COMPACT, TREECODE };
+
 private:
     SurfaceMesh& cloud;
     SurfaceMesh::Vertex_property<Vec3> vpoints;
     SurfaceMesh::Vertex_property<Vec3> vnormals;
+    Mode    mode_;
+    Scalar  support_;   ///< COMPACT: support radius of the kernel
     Mat3xN  centers_;
     VecN    weights_;
-    
+    SurfaceMesh centers_cloud_;                               ///< COMPACT: centers_, as vertices
+    std::unique_ptr<SurfaceMeshVerticesKDTree> centers_tree_; ///< COMPACT: indexes centers_cloud_
+    std::unique_ptr<SurfaceMeshVerticesKDTree> cloud_tree_;   ///< COMPACT: indexes cloud
+    std::unique_ptr<RBFTreecode> treecode_;                   ///< TREECODE: clusters centers_
+    Eigen::Vector4d polynomial_;                              ///< TREECODE: c0 + c.x term
+
 public:
-    ImplicitRBF(SurfaceMesh& cloud) : cloud(cloud){
+    /// For COMPACT, a support of 0 picks one from the sampling density
+    ImplicitRBF(SurfaceMesh& cloud, Mode mode = DENSE, Scalar support = 0) :
+        cloud(cloud), mode_(mode), support_(support){
         vpoints = cloud.get_vertex_property<Vec3>("v:point");
         vnormals = cloud.get_vertex_property<Vec3>("v:normal");
         optimize_rbf_weights();
@@ -21,14 +43,28 @@ public:
 
     /// Evaluates RBF at position p
     Scalar eval_implicit_at(const Vec3& p) const;
+    /// Evaluates RBF at each column of "points" (in parallel)
+    void eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const;
 
 private:
     /// Fit RBF to given constraints
     void optimize_rbf_weights();
+    void optimize_compact_rbf_weights(const VecN& constraints);
+    void optimize_treecode_rbf_weights(const VecN& constraints);
+    /// COMPACT evaluation, "neighbors" is a scratch buffer for the radius search
+    Scalar eval_compact_at(const Vec3& p, std::vector<std::pair<int, Scalar>>& neighbors) const;
 
     /// Evaluates RBF kernel at point _x, with center at _center
     static Scalar kernel(const Vec3& center, const Vec3& x){
         double r = (x-center).norm();
         return r*r*r;
     }
+
+    /// Wendland's C2 kernel (1-r)^4 (4r+1), positive definite in 3D, zero beyond the support
+    Scalar compact_kernel(Scalar sq_dist) const{
+        Scalar r = std::sqrt(sq_dist) / support_;
+        if(r >= 1) return 0;
+        Scalar s = 1 - r;
+        return s*s*s*s * (4*r + 1);
+    }
 };
@@ -0,0 +1,46 @@
+#include "NormalEstimator.h"
+#include <algorithm>
+
+Vec3 NormalEstimator::smallest_eigenvector(const Mat3x3& covariance){
+    // closed-form solver for 3x3 self-adjoint matrices, eigenvalues are sorted increasingly
+    Eigen::SelfAdjointEigenSolver<Mat3x3> es;
+    es.computeDirect(covariance);
+    return es.eigenvectors().col(0);
+}
+
+void NormalEstimator::exec(int k){
+    int n = cloud.n_vertices();
+    kNNs_.resize(k, n);
+    int n_chunks = (n + chunk_size - 1) / chunk_size;
+
+    #pragma omp parallel
+    {
+        // per-thread scratch buffers
+        std::vector<Scalar> sq_dists((size_t)k * chunk_size);
+        Mat3xN neighbors(3, k);
+
+        #pragma omp for schedule(dynamic)
+        for (int chunk = 0; chunk < n_chunks; ++chunk){
+            int begin = chunk * chunk_size;
+            int end = std::min(n, begin + chunk_size);
+
+            // batch kNN query of the whole chunk, straight from the "v:point" storage
+            Eigen::Map<const Mat3xN> queries((const Scalar*) (vpoints.data() + begin), 3, end - begin);
+            accelerator.kNNs(queries, k, kNNs_.col(begin).data(), sq_dists.data());
+
+            for (int i = begin; i < end; ++i){
+                const int* kNN = kNNs_.col(i).data();
+
+                // gather neighborhood and center it
+                for (int j = 0; j < k; ++j)
+                    neighbors.col(j) = vpoints[SurfaceMesh::Vertex(kNN[j])];
+                Vec3 center = neighbors.rowwise().mean();
+                neighbors.colwise() -= center;
+
+                // normal is the direction of least variance
+                Mat3x3 covariance = (neighbors * neighbors.transpose()) / Scalar(k - 1);
+                vnormals[SurfaceMesh::Vertex(i)] = smallest_eigenvector(covariance);
+            }
+        }
+    }
+}
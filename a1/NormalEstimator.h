@@ -0,0 +1,39 @@
+#pragma once
+#include <OpenGP/types.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include "internal/SurfaceMeshVerticesKDTree.h"
+
+using namespace OpenGP;
+
+/// @brief PCA normal estimation for point clouds
+/// The cloud is processed in chunks of vertices (in parallel when OpenMP is
+/// available); each thread owns its query/covariance scratch buffers, so the
+/// inner loop does not allocate.
+class NormalEstimator{
+private:
+    SurfaceMesh& cloud;
+    const SurfaceMeshVerticesKDTree& accelerator;
+    SurfaceMesh::Vertex_property<Vec3> vpoints;
+    SurfaceMesh::Vertex_property<Vec3> vnormals;
+    IndicesMatrix kNNs_; ///< k x n, column i holds the kNN of vertex i
+
+public:
+    /// Number of vertices handed to a thread at once
+    int chunk_size = 1024;
+
+public:
+    NormalEstimator(SurfaceMesh& cloud, const SurfaceMeshVerticesKDTree& accelerator) :
+        cloud(cloud), accelerator(accelerator){
+        vpoints = cloud.get_vertex_property<Vec3>("v:point");
+        vnormals = cloud.vertex_property<Vec3>("v:normal");
+    }
+
+    /// Estimates (unoriented) normals from the k nearest neighbors into "v:normal"
+    void exec(int k);
+
+    /// Neighborhoods used by the last exec(k) (k x n, column per vertex)
+    const IndicesMatrix& kNNs() const { return kNNs_; }
+
+    /// Eigenvector of the smallest eigenvalue of the (symmetric) covariance matrix
+    static Vec3 smallest_eigenvector(const Mat3x3& covariance);
+};
@@ -1,121 +1,137 @@
 #pragma once
 
-#include<float.h>
-
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include "internal/SurfaceMeshVerticesKDTree.h"
+
+/// We are representing an undirected weighted graph here. Edges are kept as
+/// a flat edge list (plus a CSR adjacency built on demand), so memory is linear
+/// in the number of edges rather than quadratic in the number of vertices.
 class Graph {
+public:
+	struct Edge {
+		int v1, v2;
+		float w;
+	};
+
+	/// Range over the neighbours of a vertex (contiguous slice of the CSR)
+	struct Neighbors {
+		const int* b;
+		const int* e;
+		const int* begin() const { return b; }
+		const int* end() const { return e; }
+	};
 
 private:
-	float ** g;
 	int n;
-
-	int min_idx(float* C, int n) {
-		int toReturn = 0;
-		float current = FLT_MAX;
-		for (int i = 0; i < n; i++) {
-			if (C[i] < FLT_MAX) toReturn = i;
+	std::vector<Edge> edges;
+	std::vector<int> offsets;   ///< CSR row pointers (n+1)
+	std::vector<int> adjacency; ///< CSR column indices (2 per edge)
+
+	/// Union-find with path halving and union by size
+	struct DisjointSets {
+		std::vector<int> parent, size;
+		DisjointSets(int n) : parent(n), size(n, 1) {
+			std::iota(parent.begin(), parent.end(), 0);
 		}
-		return toReturn;
-	}
+		int find(int i) {
+			while (parent[i] != i) {
+				parent[i] = parent[parent[i]];
+				i = parent[i];
+			}
+			return i;
+		}
+		bool merge(int i, int j) {
+			i = find(i); j = find(j);
+			if (i == j) return false;
+			if (size[i] < size[j]) std::swap(i, j);
+			parent[j] = i;
+			size[i] += size[j];
+			return true;
+		}
+	};
 
-	int idx_of(std::vector<int> Q, int k) {
-		for (int i = 0; i < Q.size(); i++) {
-			if (Q.at(i) == k) return i;
+	void build_adjacency() {
+		offsets.assign(n + 1, 0);
+		for (const Edge& e : edges) {
+			offsets[e.v1 + 1]++;
+			offsets[e.v2 + 1]++;
+		}
+		for (int i = 0; i < n; i++)
+			offsets[i + 1] += offsets[i];
+
+		adjacency.resize(offsets[n]);
+		std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+		for (const Edge& e : edges) {
+			adjacency[cursor[e.v1]++] = e.v2;
+			adjacency[cursor[e.v2]++] = e.v1;
 		}
-		return -1;
 	}
 
 public:
-	
-	// We are representing an undirected wieghted graph here
-	Graph(int n_vertices) {
-		
-		n = n_vertices;
-
-		// Allocate a adjacency matrix
-		g = new float*[n_vertices];
-		for (int i = 0; i < n_vertices; i++) {
-			g[i] = new float[n_vertices];
-			for (int j = 0; j < n_vertices; j++) {
-				g[i][j] = -1;
+
+	Graph(int n_vertices) : n(n_vertices) {}
+
+	/// Builds the Riemannian graph of a point cloud from its k x n neighbour table
+	/// (column i holds the kNN of vertex i); the weight of edge (i,j) is 1-|n_i.n_j|,
+	/// so that MST edges connect points with (nearly) parallel tangent planes.
+	Graph(const OpenGP::IndicesMatrix& kNNs,
+	      OpenGP::SurfaceMesh::Vertex_property<OpenGP::Vec3> vnormals) : n((int)kNNs.cols()) {
+		edges.reserve(kNNs.size());
+		for (int i = 0; i < n; i++) {
+			const OpenGP::Vec3& n_i = vnormals[OpenGP::SurfaceMesh::Vertex(i)];
+			for (int k = 0; k < kNNs.rows(); k++) {
+				int j = kNNs(k, i);
+				if (i == j) continue;
+				double weight = 1 - std::abs(n_i.dot(vnormals[OpenGP::SurfaceMesh::Vertex(j)]));
+				addEdge(i, j, (float)weight);
 			}
 		}
-
 	}
 
-	
 	void addEdge(int v1, int v2, float w) {
-		g[v1][v2] = w;
-		g[v2][v1] = w;
-	}
-
-	float at(int i, int j) {
-		return g[i][j];
+		edges.push_back({ v1, v2, w });
+		adjacency.clear(); ///< invalidates CSR
 	}
 
-	Graph* MST() {
-
-		// https://en.wikipedia.org/wiki/Prim%27s_algorithm
+	int n_vertices() const { return n; }
+	size_t n_edges() const { return edges.size(); }
 
-		Graph* F = new Graph(this->n);
-		float* C = new float[this->n]; 
-		int* E = new int[this->n];
-		std::vector<int> Q;
-
-		for (int i = 0; i < this->n; i++) {
-			C[i] = FLT_MAX; //any number than max edge weight;
-			E[i] = -1;
-			Q.push_back(i);
-		}
-
-		// Repeast until Q is empty
-		while (Q.size() > 0) {
-
-			// Remove from Q the v with the smallest C[v]
-			float current = FLT_MAX;
-			int v = 0;
-			int idx = 0;
-			for (int i = 0; i < Q.size(); i++) {
-				if (C[Q.at(i)] < current) {
-					v = Q.at(i);
-					idx = i;
-				}
-			}
-
-			Q.erase(Q.begin() + idx);
-
-			//Add v to F, 
-			if (E[v] != -1) {
-				// copy edge into output
-				int i = E[v] / (this->n);
-				int j = E[v] % (this->n);
-				F->addEdge(i, j, this->g[i][j]);
-			}
-
-			
-			for (int w = 0; w < this->n; w++)  {
-				// for each edge vw
-				if (this->g[v][w] != -1) {
-
-					// if w in Q
-					if (!(idx_of(Q, w) < 0)) {
-
-						// if this edge is less cost than C[w]
-						if (this->g[v][w] < C[w]) {
-							C[w] = this->g[v][w];
-							E[w] = v*(this->n) + w;
-						}
-
-					}
+	/// Neighbours of v (duplicate kNN edges i->j, j->i are listed twice)
+	Neighbors neighbors(int v) {
+		if (adjacency.empty() && !edges.empty())
+			build_adjacency();
+		if (adjacency.empty())
+			return { nullptr, nullptr };
+		return { adjacency.data() + offsets[v], adjacency.data() + offsets[v + 1] };
+	}
 
-				}
+	/// Minimum spanning forest by Kruskal's algorithm, O(E log E) time, O(V+E) memory
+	/// https://en.wikipedia.org/wiki/Kruskal%27s_algorithm
+	Graph MST() const {
+		Graph F(n);
+		F.edges.reserve(n > 0 ? n - 1 : 0);
+
+		// Sort edge indices (not edges) by weight
+		std::vector<int> order(edges.size());
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [this](int a, int b) {
+			return edges[a].w < edges[b].w;
+		});
+
+		// Greedily add edges that join two different trees
+		DisjointSets forest(n);
+		for (int i : order) {
+			const Edge& e = edges[i];
+			if (forest.merge(e.v1, e.v2)) {
+				F.edges.push_back(e);
+				if ((int)F.edges.size() == n - 1) break;
 			}
-
 		}
 
 		return F;
-		
-
 	}
 
-
-};
\ No newline at end of file
+};
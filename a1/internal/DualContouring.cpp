@@ -0,0 +1,184 @@
+#include "DualContouring.h"
+#include <algorithm>
+#include <OpenGP/MLogger.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+const int DualContouring::edges[12][2] = {
+    {0, 4}, {1, 5}, {2, 6}, {3, 7},  // x
+    {0, 2}, {1, 3}, {4, 6}, {5, 7},  // y
+    {0, 1}, {2, 3}, {4, 5}, {6, 7}   // z
+};
+
+void DualContouring::collect_quads(const Octree& octree, Scalar isoval, std::vector<Quad>& quads){
+    const std::vector<Octree::Cell>& cells = octree.cells();
+    // quadrants around an edge along axis a, counter-clockwise around +a
+    static const int sb[4] = {-1, 1, 1, -1};
+    static const int sc[4] = {-1, -1, 1, 1};
+
+    const int chunk_size = 1024;
+    int n_chunks = ((int) cells.size() + chunk_size - 1) / chunk_size;
+    std::vector<std::vector<Quad>> chunks(n_chunks);
+
+    #pragma omp parallel for schedule(dynamic)
+    for(int chunk = 0; chunk < n_chunks; ++chunk){
+        int end = std::min((int) cells.size(), (chunk + 1) * chunk_size);
+        for(int id = chunk * chunk_size; id < end; ++id){
+            const Octree::Cell& cell = cells[id];
+            if(cell.children >= 0) continue;
+            for(int e = 0; e < 12; ++e){
+                Octree::Vector3u p0 = octree.corner(cell, edges[e][0]);
+                Octree::Vector3u p1 = octree.corner(cell, edges[e][1]);
+                bool inside0 = octree.value(p0) > isoval;
+                bool inside1 = octree.value(p1) > isoval;
+                if(inside0 == inside1) continue;
+
+                // leaves around the edge, located just off its midpoint (half finest cell units)
+                int a = e / 4, b = (a + 1) % 3, c = (a + 2) % 3;
+                Eigen::Vector3i mid = 2 * p0.cast<int>();
+                mid[a] += octree.size(cell);
+                Quad quad;
+                bool minimal = true;
+                for(int q = 0; q < 4 && minimal; ++q){
+                    Eigen::Vector3i p = mid;
+                    p[b] += sb[q];
+                    p[c] += sc[q];
+                    quad.leaves[q] = octree.locate(p);
+                    minimal = quad.leaves[q] >= 0 && cells[quad.leaves[q]].depth <= cell.depth;
+                }
+                if(!minimal) continue;
+
+                // among the deepest leaves around the edge, only the first one emits it
+                int first = 0;
+                while(cells[quad.leaves[first]].depth != cell.depth) ++first;
+                if(quad.leaves[first] != id) continue;
+
+                // orient the polygon towards the outside (values below isoval)
+                if(inside1) std::swap(quad.leaves[1], quad.leaves[3]);
+                quad.inside = inside0 ? p0 : p1;
+                chunks[chunk].push_back(quad);
+            }
+        }
+    }
+
+    quads.clear();
+    for(const std::vector<Quad>& chunk : chunks)
+        quads.insert(quads.end(), chunk.begin(), chunk.end());
+}
+
+int DualContouring::leaf_sheets(const Octree& octree, const Octree::Cell& cell, Scalar isoval, Sheets& sheets){
+    // inside corners connected along the edges of the leaf (ambiguous faces separate them)
+    bool inside[8];
+    for(int k = 0; k < 8; ++k){
+        inside[k] = octree.value(octree.corner(cell, k)) > isoval;
+        sheets[k] = -1;
+    }
+    int n_sheets = 0;
+    for(int k = 0; k < 8; ++k){
+        if(!inside[k] || sheets[k] >= 0) continue;
+        int stack[8], top = 0;
+        stack[top++] = k;
+        sheets[k] = n_sheets;
+        while(top > 0){
+            int corner = stack[--top];
+            for(int e = 0; e < 12; ++e){
+                int other = (edges[e][0] == corner) ? edges[e][1] : (edges[e][1] == corner) ? edges[e][0] : -1;
+                if(other < 0 || !inside[other] || sheets[other] >= 0) continue;
+                sheets[other] = n_sheets;
+                stack[top++] = other;
+            }
+        }
+        ++n_sheets;
+    }
+    return std::max(n_sheets, 1);
+}
+
+int DualContouring::sheet_near(const Octree& octree, const Octree::Cell& cell, const Sheets& sheets, int n_sheets,
+                               const Octree::Vector3u& p){
+    if(n_sheets == 1) return 0;
+    // the inside endpoint of the edge is a corner of the leaf, or lies on one of its
+    // edges or faces (depth changes): take the sheet of the nearest inside corner
+    int best = -1;
+    int64_t best_distance = 0;
+    for(int k = 0; k < 8; ++k){
+        if(sheets[k] < 0) continue;
+        Eigen::Matrix<int64_t, 3, 1> d = octree.corner(cell, k).cast<int64_t>() - p.cast<int64_t>();
+        int64_t distance = d.squaredNorm();
+        if(best < 0 || distance < best_distance){
+            best = k;
+            best_distance = distance;
+        }
+    }
+    return sheets[best];
+}
+
+Vec3 DualContouring::solve_qef(const std::vector<Vec3>& points, const std::vector<Vec3>& normals,
+                               const Vec3& lo, const Vec3& hi){
+    // minimize sum (n_i.(x - p_i))^2, solved around the mass point with a truncated SVD
+    Vec3 mass = Vec3::Zero();
+    for(const Vec3& p : points)
+        mass += p;
+    mass /= Scalar(points.size());
+
+    Mat3x3 A = Mat3x3::Zero();
+    Vec3 rhs = Vec3::Zero();
+    for(size_t i = 0; i < points.size(); ++i){
+        A += normals[i] * normals[i].transpose();
+        rhs += normals[i] * normals[i].dot(points[i] - mass);
+    }
+    Eigen::JacobiSVD<Mat3x3> svd(A, Eigen::ComputeFullU | Eigen::ComputeFullV);
+    Vec3 sigma = svd.singularValues();
+    Vec3 sigma_inv;
+    for(int i = 0; i < 3; ++i)
+        sigma_inv[i] = (sigma[i] > Scalar(0.1) * sigma[0]) ? 1 / sigma[i] : 0;
+    Vec3 x = mass + svd.matrixV() * sigma_inv.asDiagonal() * svd.matrixU().transpose() * rhs;
+
+    // keep the vertex in its cell
+    if((x.array() < lo.array()).any() || (x.array() > hi.array()).any())
+        return mass;
+    return x;
+}
+
+void DualContouring::build_mesh(const std::vector<Vec3>& vertices, const std::vector<std::array<int, 4>>& polygons, SurfaceMesh& mesh){
+    mesh.reserve(vertices.size(), 3 * polygons.size(), 2 * polygons.size());
+    for(const Vec3& p : vertices)
+        mesh.add_vertex(p);
+
+    // triangles that would make the mesh non-manifold get their own copies of
+    // the vertices, at the same positions, rather than leaving a hole
+    int duplicated = 0;
+    auto add_triangle = [&](int v0, int v1, int v2){
+        SurfaceMesh::Face f = mesh.add_triangle(SurfaceMesh::Vertex(v0), SurfaceMesh::Vertex(v1), SurfaceMesh::Vertex(v2));
+        if(f.is_valid()) return;
+        mesh.add_triangle(mesh.add_vertex(vertices[v0]), mesh.add_vertex(vertices[v1]), mesh.add_vertex(vertices[v2]));
+        ++duplicated;
+    };
+    for(const std::array<int, 4>& polygon : polygons){
+        // leaves shared by two quadrants (depth changes) give triangles
+        int poly[4], n = 0;
+        for(int id : polygon)
+            if(n == 0 || poly[n - 1] != id) poly[n++] = id;
+        if(n > 1 && poly[n - 1] == poly[0]) --n;
+
+        if(n == 3)
+            add_triangle(poly[0], poly[1], poly[2]);
+        else if(n == 4){
+            // split along the shorter diagonal
+            if((vertices[poly[0]] - vertices[poly[2]]).squaredNorm() <= (vertices[poly[1]] - vertices[poly[3]]).squaredNorm()){
+                add_triangle(poly[0], poly[1], poly[2]);
+                add_triangle(poly[0], poly[2], poly[3]);
+            } else {
+                add_triangle(poly[0], poly[1], poly[3]);
+                add_triangle(poly[1], poly[2], poly[3]);
+            }
+        }
+    }
+    if(duplicated > 0)
+        mWarning() << "DualContouring:" << duplicated << "non-manifold triangles added with duplicated vertices (open seams)";
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
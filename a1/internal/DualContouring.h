@@ -0,0 +1,123 @@
+#pragma once
+#include <array>
+#include <vector>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+#include "Octree.h"
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Dual contouring (Ju et al. 2002) of an adaptive Octree. Every leaf gets one
+/// vertex per surface sheet crossing it (its inside corners, connected along
+/// its edges, as in manifold dual contouring), placed by minimizing the error to
+/// the tangent planes at the crossings of the sheet's edges; every minimal
+/// sign-changing edge (one not subdivided by a deeper neighbor) is connected to
+/// the vertices of the 3 or 4 leaves around it. Coarse leaves can still be
+/// crossed by a fine edge with no matching sign change on their own corners; the
+/// triangles that would then be non-manifold are added with duplicated vertices,
+/// so the surface has no holes but is not guaranteed to be a closed manifold
+/// across depth changes.
+class DualContouring{
+public:
+    /// The implicit is only used for the tangent planes (finite differences)
+    template <class Implicit>
+    static void exec(const Octree& octree, const Implicit& implicit, SurfaceMesh& mesh, Scalar isoval = 0);
+
+private:
+    /// Leaves around a sign-changing edge, counter-clockwise w.r.t. the outside,
+    /// and the endpoint of the edge above isoval
+    struct Quad{
+        std::array<int, 4> leaves;
+        Octree::Vector3u inside;
+    };
+    typedef std::array<int, 8> Sheets; ///< sheet of each corner of a leaf, -1 for corners below isoval
+    static const int edges[12][2];    ///< corner pairs, edges 4a..4a+3 are along axis a
+    static void collect_quads(const Octree& octree, Scalar isoval, std::vector<Quad>& quads);
+    static int leaf_sheets(const Octree& octree, const Octree::Cell& cell, Scalar isoval, Sheets& sheets);
+    static int sheet_near(const Octree& octree, const Octree::Cell& cell, const Sheets& sheets, int n_sheets,
+                          const Octree::Vector3u& p);
+    static Vec3 solve_qef(const std::vector<Vec3>& points, const std::vector<Vec3>& normals,
+                          const Vec3& lo, const Vec3& hi);
+    static void build_mesh(const std::vector<Vec3>& vertices, const std::vector<std::array<int, 4>>& polygons, SurfaceMesh& mesh);
+};
+
+template <class Implicit>
+void DualContouring::exec(const Octree& octree, const Implicit& implicit, SurfaceMesh& mesh, Scalar isoval){
+    mesh.clear(); //< safety
+    std::vector<Quad> quads;
+    collect_quads(octree, isoval, quads);
+
+    // sheets of the leaves used by a polygon
+    const std::vector<Octree::Cell>& cells = octree.cells();
+    std::vector<int> slot(cells.size(), -1);
+    std::vector<int> leaves;
+    for(const Quad& quad : quads)
+        for(int id : quad.leaves)
+            if(slot[id] < 0){
+                slot[id] = (int) leaves.size();
+                leaves.push_back(id);
+            }
+    std::vector<Sheets> sheets(leaves.size());
+    std::vector<int> first(leaves.size() + 1, 0);
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(int i = 0; i < (int) leaves.size(); ++i)
+        first[i + 1] = leaf_sheets(octree, cells[leaves[i]], isoval, sheets[i]);
+    for(size_t i = 0; i < leaves.size(); ++i)
+        first[i + 1] += first[i];
+
+    // one vertex per sheet, the polygons use the sheet nearest to their edge
+    std::vector<std::array<int, 4>> polygons(quads.size());
+    for(size_t q = 0; q < quads.size(); ++q)
+        for(int k = 0; k < 4; ++k){
+            int i = slot[quads[q].leaves[k]];
+            const Octree::Cell& cell = cells[leaves[i]];
+            polygons[q][k] = first[i] + sheet_near(octree, cell, sheets[i], first[i + 1] - first[i], quads[q].inside);
+        }
+
+    // place the vertices (in parallel, the implicit must be safe to call concurrently)
+    std::vector<Vec3> vertices(first.back());
+    const Scalar step = octree.h() / 2;
+    #pragma omp parallel
+    {
+        std::vector<Vec3> points[4], normals[4];
+        #pragma omp for schedule(dynamic, 64)
+        for(int i = 0; i < (int) leaves.size(); ++i){
+            const Octree::Cell& cell = cells[leaves[i]];
+            int n_sheets = first[i + 1] - first[i];
+            for(int s = 0; s < n_sheets; ++s){
+                points[s].clear();
+                normals[s].clear();
+            }
+            for(int e = 0; e < 12; ++e){
+                Octree::Vector3u a = octree.corner(cell, edges[e][0]);
+                Octree::Vector3u b = octree.corner(cell, edges[e][1]);
+                Scalar va = octree.value(a), vb = octree.value(b);
+                if((va > isoval) == (vb > isoval))
+                    continue;
+                Scalar t = (isoval - va) / (vb - va);
+                Vec3 p = (1 - t) * octree.point(a) + t * octree.point(b);
+                Vec3 n;
+                for(int d = 0; d < 3; ++d){
+                    Vec3 dp = Vec3::Zero();
+                    dp[d] = step;
+                    n[d] = implicit.eval_implicit_at(p + dp) - implicit.eval_implicit_at(p - dp);
+                }
+                int s = sheets[i][va > isoval ? edges[e][0] : edges[e][1]];
+                points[s].push_back(p);
+                normals[s].push_back(n.norm() > 0 ? Vec3(n.normalized()) : Vec3(Vec3::Zero()));
+            }
+            Vec3 lo = octree.point(cell.min);
+            Vec3 hi = octree.point(cell.min + Octree::Vector3u::Constant(octree.size(cell)));
+            for(int s = 0; s < n_sheets; ++s)
+                vertices[first[i] + s] = points[s].empty() ? Vec3((lo + hi) / 2) : solve_qef(points[s], normals[s], lo, hi);
+        }
+    }
+
+    build_mesh(vertices, polygons, mesh);
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,158 @@
+#pragma once
+#include <algorithm>
+#include <vector>
+#include <utility>
+#include "Grid.h"
+#include "SparseGrid.h"
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Fills a Grid with the values of an implicit function, i.e. any class providing
+///     Scalar eval_implicit_at(const Vec3& p) const;
+/// which must be safe to call concurrently. The grid is split in (x,y) tiles of
+/// complete z-rows; tiles are evaluated in parallel (OpenMP) and cells within a tile
+/// are visited z-fastest, the same order in which Grid stores them. Implicits that
+/// also provide
+///     void eval_implicit_at(const Eigen::Ref<const Mat3xN>& points, VecN& values) const;
+/// get a whole tile (or brick) per call instead, walked in serpentine order so that
+/// consecutive points are grid neighbors (which e.g. ImplicitHoppe exploits to bound
+/// its searches); the point and value buffers are then reused by each thread.
+class GridSampler{
+public:
+    typedef Eigen::Matrix<unsigned int, 3, 1> Vector3u;
+
+    template <class Implicit>
+    static void exec(Grid& grid, const Implicit& implicit, unsigned int tile_size = 8){
+        sample(grid, implicit, tile_size, 0);
+    }
+
+    /// Sparse version: only the active bricks are evaluated (in parallel, one brick per task)
+    template <class Implicit>
+    static void exec(SparseGrid& grid, const Implicit& implicit){
+        sample(grid, implicit, 0);
+    }
+
+private:
+    /// Batch evaluation, one call per tile (preferred overload, int argument)...
+    template <class Implicit>
+    static auto sample(Grid& grid, const Implicit& implicit, unsigned int tile_size, int)
+        -> decltype(implicit.eval_implicit_at(std::declval<const Mat3xN&>(), std::declval<VecN&>()), void()){
+        int xres = grid.xResolution();
+        int yres = grid.yResolution();
+        int zres = grid.zResolution();
+        int xtiles = (xres + tile_size - 1) / tile_size;
+        int ytiles = (yres + tile_size - 1) / tile_size;
+        int ntiles = xtiles * ytiles;
+
+        #pragma omp parallel
+        {
+            std::vector<Vector3u> cells;
+            Mat3xN points;
+            VecN values;
+            #pragma omp for schedule(dynamic)
+            for(int tile = 0; tile < ntiles; ++tile){
+                unsigned int x0 = (tile / ytiles) * tile_size;
+                unsigned int y0 = (tile % ytiles) * tile_size;
+                serpentine(Vector3u(x0, y0, 0),
+                           Vector3u(std::min<int>(xres, x0 + tile_size), std::min<int>(yres, y0 + tile_size), zres), cells);
+                points.resize(3, cells.size());
+                for(size_t i = 0; i < cells.size(); ++i)
+                    points.col(i) = grid.point(cells[i][0], cells[i][1], cells[i][2]);
+                implicit.eval_implicit_at(points, values);
+                for(size_t i = 0; i < cells.size(); ++i)
+                    grid(cells[i][0], cells[i][1], cells[i][2]) = values(i);
+            }
+        }
+    }
+    /// ...one point at a time otherwise, written in place
+    template <class Implicit>
+    static void sample(Grid& grid, const Implicit& implicit, unsigned int tile_size, long){
+        int xres = grid.xResolution();
+        int yres = grid.yResolution();
+        int zres = grid.zResolution();
+        int xtiles = (xres + tile_size - 1) / tile_size;
+        int ytiles = (yres + tile_size - 1) / tile_size;
+        int ntiles = xtiles * ytiles;
+
+        #pragma omp parallel for schedule(dynamic)
+        for(int tile = 0; tile < ntiles; ++tile){
+            int x0 = (tile / ytiles) * tile_size;
+            int y0 = (tile % ytiles) * tile_size;
+            int x1 = std::min<int>(xres, x0 + tile_size);
+            int y1 = std::min<int>(yres, y0 + tile_size);
+            for(int x = x0; x < x1; ++x)
+                for(int y = y0; y < y1; ++y)
+                    for(int z = 0; z < zres; ++z)
+                        grid(x, y, z) = implicit.eval_implicit_at( grid.point(x, y, z) );
+        }
+    }
+
+    /// Batch evaluation, one call per brick (preferred overload, int argument)...
+    template <class Implicit>
+    static auto sample(SparseGrid& grid, const Implicit& implicit, int)
+        -> decltype(implicit.eval_implicit_at(std::declval<const Mat3xN&>(), std::declval<VecN&>()), void()){
+        const unsigned int B = SparseGrid::BRICK;
+        int nbricks = grid.n_bricks();
+
+        #pragma omp parallel
+        {
+            std::vector<Vector3u> cells;
+            Mat3xN points;
+            VecN values;
+            #pragma omp for schedule(dynamic)
+            for(int id = 0; id < nbricks; ++id){
+                SparseGrid::Vector3u first = grid.brick(id) * B;
+                Scalar* brick_values = grid.brick_values(id);
+                serpentine(first, Vector3u(std::min(grid.xResolution(), first[0] + B),
+                                           std::min(grid.yResolution(), first[1] + B),
+                                           std::min(grid.zResolution(), first[2] + B)), cells);
+                points.resize(3, cells.size());
+                for(size_t i = 0; i < cells.size(); ++i)
+                    points.col(i) = grid.point(cells[i][0], cells[i][1], cells[i][2]);
+                implicit.eval_implicit_at(points, values);
+                for(size_t i = 0; i < cells.size(); ++i)
+                    brick_values[SparseGrid::brick_offset(cells[i])] = values(i);
+            }
+        }
+    }
+    /// ...one point at a time otherwise, written in place
+    template <class Implicit>
+    static void sample(SparseGrid& grid, const Implicit& implicit, long){
+        const unsigned int B = SparseGrid::BRICK;
+        int nbricks = grid.n_bricks();
+
+        #pragma omp parallel for schedule(dynamic)
+        for(int id = 0; id < nbricks; ++id){
+            SparseGrid::Vector3u first = grid.brick(id) * B;
+            Scalar* values = grid.brick_values(id);
+            unsigned int x1 = std::min(grid.xResolution(), first[0] + B);
+            unsigned int y1 = std::min(grid.yResolution(), first[1] + B);
+            unsigned int z1 = std::min(grid.zResolution(), first[2] + B);
+            for(unsigned int x = first[0]; x < x1; ++x)
+                for(unsigned int y = first[1]; y < y1; ++y)
+                    for(unsigned int z = first[2]; z < z1; ++z)
+                        values[SparseGrid::brick_offset(SparseGrid::Vector3u(x, y, z))] =
+                            implicit.eval_implicit_at( grid.point(x, y, z) );
+        }
+    }
+
+    /// Cells of [begin, end), z-fastest, reversing the z (y) direction on every other row (column)
+    static void serpentine(const Vector3u& begin, const Vector3u& end, std::vector<Vector3u>& cells){
+        cells.clear();
+        cells.reserve((end - begin).prod());
+        bool y_forward = true, z_forward = true;
+        for(unsigned int x = begin[0]; x < end[0]; ++x, y_forward = !y_forward)
+            for(unsigned int j = begin[1]; j < end[1]; ++j, z_forward = !z_forward)
+                for(unsigned int k = begin[2]; k < end[2]; ++k){
+                    unsigned int y = y_forward ? j : begin[1] + end[1] - 1 - j;
+                    unsigned int z = z_forward ? k : begin[2] + end[2] - 1 - k;
+                    cells.push_back(Vector3u(x, y, z));
+                }
+    }
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -1,125 +1,323 @@
 #include "MarchingCubes.h"
+#include <algorithm>
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
-void MarchingCubes::exec(const Grid &grid, SurfaceMesh &mesh, Scalar isoval){
-    mesh.clear(); //< safety
-    MarchingCubes mc(grid, mesh, isoval);
-}
+/// Output of a slab of cube layers [x0,x1). Vertices are numbered locally; the
+/// vertices on the y/z-edges of the first/last grid plane are shared with the
+/// neighboring slabs and listed (in the same y,z,axis order) for stitching.
+struct MarchingCubes::Slab{
+    std::vector<Vec3> vertices;
+    std::vector<Edge> edges;      ///< grid edge of each vertex
+    std::vector<int> triangles;   ///< 3 local vertex ids per triangle
+    std::vector<int> first_plane; ///< local ids of the vertices on plane x0
+    std::vector<int> last_plane;  ///< local ids of the vertices on plane x1
+};
 
-MarchingCubes::MarchingCubes(Grid const& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval /* = 0 */) :
-    mGrid(grid),
-    mMesh(mesh),
-    mIsoVal(isoval)
-{
-    unsigned long int i = std::numeric_limits<unsigned long int>::max();
-    i /= grid.xResolution();
-    i /= grid.yResolution();
-    i /= grid.zResolution();
-    i >>= 2;
-    if (!i)
-    {
-        std::cerr << "MarchingCubes: grid resolution too high!\n";
+void MarchingCubes::exec(const Grid &grid, SurfaceMesh &mesh, Scalar isoval, std::vector<Edge>* edges){
+    mesh.clear(); //< safety
+    if (edges) edges->clear();
+    const unsigned int xres = grid.xResolution();
+    if (xres < 2 || grid.yResolution() < 2 || grid.zResolution() < 2)
         return;
-    }
 
-    // Process all cubes.
-    for (unsigned int x = 0; x < grid.xResolution() - 1; ++x)
+    // Extract slabs of cube layers independently
+    const unsigned int thickness = 16;
+    const int nslabs = (xres - 1 + thickness - 1) / thickness;
+    std::vector<Slab> slabs(nslabs);
+    #pragma omp parallel for schedule(dynamic)
+    for (int s = 0; s < nslabs; ++s)
+        processSlab(grid, isoval, s * thickness, std::min(xres - 1, (s + 1) * thickness), slabs[s]);
+
+    // Stitch: vertices on a slab's first plane are those on the previous slab's last plane
+    std::vector<std::vector<int>> local2global(nslabs);
+    int nvertices = 0, nfaces = 0;
+    for (int s = 0; s < nslabs; ++s)
     {
-        for (unsigned int y = 0; y < grid.yResolution() - 1; ++y)
+        std::vector<int>& map = local2global[s];
+        map.assign(slabs[s].vertices.size(), -1);
+        if (s > 0)
         {
-            for (unsigned int z = 0; z < grid.zResolution() - 1; ++z)
-            {
-                processCube(x, y, z);
-            }
+            const std::vector<int>& first = slabs[s].first_plane;
+            const std::vector<int>& last = slabs[s - 1].last_plane;
+            assert(first.size() == last.size());
+            for (size_t i = 0; i < first.size(); ++i)
+                map[first[i]] = local2global[s - 1][last[i]];
         }
+        for (int& id : map)
+            if (id < 0) id = nvertices++;
+        nfaces += slabs[s].triangles.size() / 3;
+    }
 
+    // Build the mesh in bulk (new vertices are created in global id order)
+    mesh.reserve(nvertices, 3 * nfaces / 2, nfaces);
+    if (edges) edges->reserve(nvertices);
+    int next = 0;
+    for (int s = 0; s < nslabs; ++s)
+        for (size_t i = 0; i < slabs[s].vertices.size(); ++i)
+            if (local2global[s][i] == next)
+            {
+                mesh.add_vertex(slabs[s].vertices[i]);
+                if (edges) edges->push_back(slabs[s].edges[i]);
+                ++next;
+            }
+    for (int s = 0; s < nslabs; ++s)
+    {
+        const std::vector<int>& tris = slabs[s].triangles;
+        const std::vector<int>& map = local2global[s];
+        for (size_t i = 0; i < tris.size(); i += 3)
+            mesh.add_triangle(SurfaceMesh::Vertex(map[tris[i]]),
+                              SurfaceMesh::Vertex(map[tris[i + 1]]),
+                              SurfaceMesh::Vertex(map[tris[i + 2]]));
     }
 }
 
-void MarchingCubes::processCube(unsigned int x, unsigned int y, unsigned int z)
+void MarchingCubes::processSlab(const Grid& grid, Scalar isoval, unsigned int x0, unsigned int x1, Slab& slab)
 {
-    using namespace OpenGP;
-
-    Vector3u corner[8];
-    SurfaceMesh::Vertex samples[12];
-    unsigned char cubeType(0);
-    unsigned int i;
+    const unsigned int yres = grid.yResolution();
+    const unsigned int zres = grid.zResolution();
+    const unsigned int nplane = yres * zres;
 
-    // Get point indeces of corner vertices
-    corner[0] = Vector3u(x, y, z);
-    corner[1] = Vector3u(x + 1, y, z);
-    corner[2] = Vector3u(x + 1, y + 1, z);
-    corner[3] = Vector3u(x, y + 1, z);
-    corner[4] = Vector3u(x, y, z + 1);
-    corner[5] = Vector3u(x + 1, y, z + 1);
-    corner[6] = Vector3u(x + 1, y + 1, z + 1);
-    corner[7] = Vector3u(x, y + 1, z + 1);
+    // Edge vertex ids (-1: no crossing), indexed by the lower grid point (y*zres+z).
+    // y/z-edges of the two grid planes of the current cube layer, x-edges in between.
+    std::vector<int> yedges0(nplane), zedges0(nplane), yedges1(nplane), zedges1(nplane), xedges(nplane);
 
+    auto addVertex = [&](Vector3u const& p0, Vector3u const& p1) -> int
+    {
+        float s0 = fabs(grid(p0) - isoval);
+        float s1 = fabs(grid(p1) - isoval);
+        float t = s0 / (s0 + s1);
+        slab.vertices.push_back((1.0f - t)*grid.point(p0) + t*grid.point(p1));
+        Edge edge = {p0, (p1[0] != p0[0]) ? 0 : (p1[1] != p0[1]) ? 1 : 2};
+        slab.edges.push_back(edge);
+        return (int) slab.vertices.size() - 1;
+    };
+    auto inside = [&](unsigned int x, unsigned int y, unsigned int z)
+    {
+        return grid(x, y, z) > isoval;
+    };
+    auto computePlane = [&](unsigned int x, std::vector<int>& yedges, std::vector<int>& zedges, std::vector<int>* shared)
+    {
+        for (unsigned int y = 0; y < yres; ++y)
+            for (unsigned int z = 0; z < zres; ++z)
+            {
+                unsigned int i = y * zres + z;
+                bool in = inside(x, y, z);
+                yedges[i] = (y + 1 < yres && in != inside(x, y + 1, z)) ?
+                            addVertex(Vector3u(x, y, z), Vector3u(x, y + 1, z)) : -1;
+                zedges[i] = (z + 1 < zres && in != inside(x, y, z + 1)) ?
+                            addVertex(Vector3u(x, y, z), Vector3u(x, y, z + 1)) : -1;
+                if (shared)
+                {
+                    if (yedges[i] >= 0) shared->push_back(yedges[i]);
+                    if (zedges[i] >= 0) shared->push_back(zedges[i]);
+                }
+            }
+    };
 
-    // determine cube type
-    for (i = 0; i<8; ++i)
-        if (mGrid(corner[i]) > mIsoVal)
-            cubeType |= (1 << i);
-
+    computePlane(x0, yedges0, zedges0, &slab.first_plane);
+    for (unsigned int x = x0; x < x1; ++x)
+    {
+        for (unsigned int y = 0; y < yres; ++y)
+            for (unsigned int z = 0; z < zres; ++z)
+                xedges[y * zres + z] = (inside(x, y, z) != inside(x + 1, y, z)) ?
+                                       addVertex(Vector3u(x, y, z), Vector3u(x + 1, y, z)) : -1;
+        computePlane(x + 1, yedges1, zedges1, (x + 1 == x1) ? &slab.last_plane : nullptr);
 
-    // trivial reject ?
-    if (cubeType == 0 || cubeType == 255)
-        return;
+        for (unsigned int y = 0; y + 1 < yres; ++y)
+            for (unsigned int z = 0; z + 1 < zres; ++z)
+            {
+                // corner i is bit i of cubeType, numbered as in triTable
+                unsigned char cubeType(0);
+                if (inside(x,     y,     z    )) cubeType |= 1;
+                if (inside(x + 1, y,     z    )) cubeType |= 2;
+                if (inside(x + 1, y + 1, z    )) cubeType |= 4;
+                if (inside(x,     y + 1, z    )) cubeType |= 8;
+                if (inside(x,     y,     z + 1)) cubeType |= 16;
+                if (inside(x + 1, y,     z + 1)) cubeType |= 32;
+                if (inside(x + 1, y + 1, z + 1)) cubeType |= 64;
+                if (inside(x,     y + 1, z + 1)) cubeType |= 128;
+                if (cubeType == 0 || cubeType == 255)
+                    continue;
 
+                unsigned int i = y * zres + z;
+                int samples[12] = {
+                    xedges[i],             // (x,y,z)-(x+1,y,z)
+                    yedges1[i],            // (x+1,y,z)-(x+1,y+1,z)
+                    xedges[i + zres],      // (x,y+1,z)-(x+1,y+1,z)
+                    yedges0[i],            // (x,y,z)-(x,y+1,z)
+                    xedges[i + 1],         // (x,y,z+1)-(x+1,y,z+1)
+                    yedges1[i + 1],        // (x+1,y,z+1)-(x+1,y+1,z+1)
+                    xedges[i + zres + 1],  // (x,y+1,z+1)-(x+1,y+1,z+1)
+                    yedges0[i + 1],        // (x,y,z+1)-(x,y+1,z+1)
+                    zedges0[i],            // (x,y,z)-(x,y,z+1)
+                    zedges1[i],            // (x+1,y,z)-(x+1,y,z+1)
+                    zedges1[i + zres],     // (x+1,y+1,z)-(x+1,y+1,z+1)
+                    zedges0[i + zres]      // (x,y+1,z)-(x,y+1,z+1)
+                };
 
-    // compute samples on cube's edges
-    if (edgeTable[cubeType] & 1)    samples[0] = addVertex(corner[0], corner[1]);
-    if (edgeTable[cubeType] & 2)    samples[1] = addVertex(corner[1], corner[2]);
-    if (edgeTable[cubeType] & 4)    samples[2] = addVertex(corner[3], corner[2]);
-    if (edgeTable[cubeType] & 8)    samples[3] = addVertex(corner[0], corner[3]);
-    if (edgeTable[cubeType] & 16)   samples[4] = addVertex(corner[4], corner[5]);
-    if (edgeTable[cubeType] & 32)   samples[5] = addVertex(corner[5], corner[6]);
-    if (edgeTable[cubeType] & 64)   samples[6] = addVertex(corner[7], corner[6]);
-    if (edgeTable[cubeType] & 128)  samples[7] = addVertex(corner[4], corner[7]);
-    if (edgeTable[cubeType] & 256)  samples[8] = addVertex(corner[0], corner[4]);
-    if (edgeTable[cubeType] & 512)  samples[9] = addVertex(corner[1], corner[5]);
-    if (edgeTable[cubeType] & 1024) samples[10] = addVertex(corner[2], corner[6]);
-    if (edgeTable[cubeType] & 2048) samples[11] = addVertex(corner[3], corner[7]);
+                for (int t = 0; triTable[cubeType][t] != -1; ++t)
+                    slab.triangles.push_back(samples[triTable[cubeType][t]]);
+            }
 
-    // connect samples by triangles
-    for (i = 0; triTable[cubeType][i] != -1; i += 3)
-        mMesh.add_triangle(samples[triTable[cubeType][i]],
-            samples[triTable[cubeType][i + 1]],
-            samples[triTable[cubeType][i + 2]]);
+        std::swap(yedges0, yedges1);
+        std::swap(zedges0, zedges1);
+    }
 }
 
-OpenGP::SurfaceMesh::Vertex MarchingCubes::addVertex(Vector3u const& p0, Vector3u const& p1)
-{
-    using namespace OpenGP;
+void MarchingCubes::exec(const SparseGrid &grid, SurfaceMesh &mesh, Scalar isoval){
+    mesh.clear(); //< safety
+    const unsigned int B = SparseGrid::BRICK;
+    const size_t N = SparseGrid::BRICK_SIZE;
+    const int nbricks = grid.n_bricks();
+    const Vector3u res(grid.xResolution(), grid.yResolution(), grid.zResolution());
+
+    // The cubes of a brick reach one grid point into the bricks after it in x/y/z:
+    // ids of the 2x2x2 bricks starting at each brick (index dx*4+dy*2+dz, -1: inactive)
+    std::vector<int> neighbors(8 * size_t(nbricks));
+    #pragma omp parallel for
+    for (int b = 0; b < nbricks; ++b)
+    {
+        Vector3u c = grid.brick(b);
+        for (int n = 0; n < 8; ++n)
+            neighbors[8 * b + n] = grid.find_brick(c[0] + (n >> 2), c[1] + ((n >> 1) & 1), c[2] + (n & 1));
+    }
+    // Brick and value offset of local grid point (lx,ly,lz) of brick b, coordinates in [0,B]
+    auto locate = [&](int b, unsigned int lx, unsigned int ly, unsigned int lz, unsigned int& offset)
+    {
+        offset = (lz % B) + (ly % B) * B + (lx % B) * B * B;
+        return neighbors[8 * b + (lx / B) * 4 + (ly / B) * 2 + lz / B];
+    };
 
-    // compute key for edge (p0,p1)
-    unsigned long int i0 = p0[0] + p0[1] * mGrid.xResolution() + p0[2] * mGrid.xResolution()*mGrid.yResolution();
-    unsigned long int i1 = p1[0] + p1[1] * mGrid.xResolution() + p1[2] * mGrid.xResolution()*mGrid.yResolution();
-    unsigned long int idx = std::min(i0, i1);
-    idx <<= 2;
-    if (p0[0] != p1[0]) idx |= 0;
-    else if (p0[1] != p1[1]) idx |= 1;
-    else if (p0[2] != p1[2]) idx |= 2;
+    // Edge vertex ids (-1: no crossing), 3*BRICK_SIZE per brick: each edge belongs to
+    // the brick of its lower grid point, so every vertex is computed exactly once
+    std::vector<int> edges(3 * N * nbricks, -1);
+    std::vector<std::vector<Vec3>> vertices(nbricks);
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nbricks; ++b)
+    {
+        const Vector3u first = grid.brick(b) * B;
+        const Scalar* values = grid.brick_values(b);
+        int* ids = edges.data() + 3 * N * b;
+        for (unsigned int lx = 0; lx < B; ++lx)
+            for (unsigned int ly = 0; ly < B; ++ly)
+                for (unsigned int lz = 0; lz < B; ++lz)
+                {
+                    Vector3u p = first + Vector3u(lx, ly, lz);
+                    if (p[0] >= res[0] || p[1] >= res[1] || p[2] >= res[2])
+                        continue;
+                    unsigned int offset = lz + ly * B + lx * B * B;
+                    Scalar v0 = values[offset];
+                    for (int axis = 0; axis < 3; ++axis)
+                    {
+                        Vector3u q = p;
+                        if (++q[axis] >= res[axis])
+                            continue;
+                        unsigned int offset1;
+                        int n = locate(b, lx + (axis == 0), ly + (axis == 1), lz + (axis == 2), offset1);
+                        if (n < 0)
+                            continue;
+                        Scalar v1 = grid.brick_values(n)[offset1];
+                        if ((v0 > isoval) == (v1 > isoval))
+                            continue;
+                        float s0 = fabs(v0 - isoval);
+                        float s1 = fabs(v1 - isoval);
+                        float t = s0 / (s0 + s1);
+                        ids[axis * N + offset] = (int) vertices[b].size();
+                        vertices[b].push_back((1.0f - t)*grid.point(p) + t*grid.point(q));
+                    }
+                }
+    }
 
+    // Local to global vertex ids
+    std::vector<int> first_vertex(nbricks + 1, 0);
+    for (int b = 0; b < nbricks; ++b)
+        first_vertex[b + 1] = first_vertex[b] + (int) vertices[b].size();
+    #pragma omp parallel for
+    for (int b = 0; b < nbricks; ++b)
+        for (size_t i = 3 * N * b; i < 3 * N * (b + 1); ++i)
+            if (edges[i] >= 0) edges[i] += first_vertex[b];
 
-    // find vertex if it has been computed already
-    std::map<unsigned long int, SurfaceMesh::Vertex>::iterator it = mEdge2Vertex.find(idx);
-    if (it != mEdge2Vertex.end())
-        return it->second;
+    // Triangulate the cubes whose first corner lies in a brick and whose 8 corners are known
+    std::vector<std::vector<int>> triangles(nbricks);
+    #pragma omp parallel for schedule(dynamic)
+    for (int b = 0; b < nbricks; ++b)
+    {
+        const Vector3u first = grid.brick(b) * B;
+        for (unsigned int lx = 0; lx < B && first[0] + lx + 1 < res[0]; ++lx)
+            for (unsigned int ly = 0; ly < B && first[1] + ly + 1 < res[1]; ++ly)
+                for (unsigned int lz = 0; lz < B && first[2] + lz + 1 < res[2]; ++lz)
+                {
+                    // corner i is bit i of cubeType, numbered as in triTable
+                    static const unsigned int corner[8][3] = {
+                        {0, 0, 0}, {1, 0, 0}, {1, 1, 0}, {0, 1, 0}, {0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}
+                    };
+                    unsigned char cubeType(0);
+                    bool known = true;
+                    for (int i = 0; i < 8 && known; ++i)
+                    {
+                        unsigned int offset;
+                        int n = locate(b, lx + corner[i][0], ly + corner[i][1], lz + corner[i][2], offset);
+                        known = (n >= 0);
+                        if (known && grid.brick_values(n)[offset] > isoval)
+                            cubeType |= (1 << i);
+                    }
+                    if (!known || cubeType == 0 || cubeType == 255)
+                        continue;
 
+                    // edge at local grid point (x,y,z) along axis, in the brick that owns it
+                    auto edge = [&](unsigned int x, unsigned int y, unsigned int z, int axis)
+                    {
+                        unsigned int offset;
+                        int n = locate(b, x, y, z, offset);
+                        return edges[3 * N * n + axis * N + offset];
+                    };
+                    int samples[12] = {
+                        edge(lx,     ly,     lz,     0),
+                        edge(lx + 1, ly,     lz,     1),
+                        edge(lx,     ly + 1, lz,     0),
+                        edge(lx,     ly,     lz,     1),
+                        edge(lx,     ly,     lz + 1, 0),
+                        edge(lx + 1, ly,     lz + 1, 1),
+                        edge(lx,     ly + 1, lz + 1, 0),
+                        edge(lx,     ly,     lz + 1, 1),
+                        edge(lx,     ly,     lz,     2),
+                        edge(lx + 1, ly,     lz,     2),
+                        edge(lx + 1, ly + 1, lz,     2),
+                        edge(lx,     ly + 1, lz,     2)
+                    };
+                    for (int t = 0; triTable[cubeType][t] != -1; ++t)
+                        triangles[b].push_back(samples[triTable[cubeType][t]]);
+                }
+    }
 
-    // otherwise generate new vertex
-    Vec3 pp0(mGrid.point(p0));
-    Vec3 pp1(mGrid.point(p1));
-    float s0 = fabs(mGrid(p0) - mIsoVal);
-    float s1 = fabs(mGrid(p1) - mIsoVal);
-    float t = s0 / (s0 + s1);
-    SurfaceMesh::Vertex v = mMesh.add_vertex((1.0f - t)*pp0 + t*pp1);
-    mEdge2Vertex[idx] = v;
-    return v;
+    // Build the mesh in bulk, dropping the vertices of edges no triangulated cube uses
+    // (those whose cubes have a corner in an inactive brick)
+    std::vector<int> used(first_vertex[nbricks], -1);
+    int nvertices = 0, nfaces = 0;
+    for (int b = 0; b < nbricks; ++b)
+    {
+        for (int id : triangles[b])
+            used[id] = 0;
+        nfaces += triangles[b].size() / 3;
+    }
+    for (int& id : used)
+        if (id == 0) id = nvertices++;
+    mesh.reserve(nvertices, 3 * nfaces / 2, nfaces);
+    for (int b = 0; b < nbricks; ++b)
+        for (size_t i = 0; i < vertices[b].size(); ++i)
+            if (used[first_vertex[b] + i] >= 0)
+                mesh.add_vertex(vertices[b][i]);
+    for (int b = 0; b < nbricks; ++b)
+    {
+        const std::vector<int>& tris = triangles[b];
+        for (size_t i = 0; i < tris.size(); i += 3)
+            mesh.add_triangle(SurfaceMesh::Vertex(used[tris[i]]),
+                              SurfaceMesh::Vertex(used[tris[i + 1]]),
+                              SurfaceMesh::Vertex(used[tris[i + 2]]));
+    }
 }
 
 int MarchingCubes::edgeTable[256] =
@@ -1,34 +1,39 @@
 #pragma once
-#include <map>
+#include <vector>
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
 
 #include "Grid.h"
+#include "SparseGrid.h"
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
-/// TODO remove me
-void marchingCubes(Grid const& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval = 0);
-
 class MarchingCubes{
 public:
     typedef Eigen::Matrix<unsigned int, 3, 1> Vector3u;
+    /// Grid edge a vertex lies on: its lower grid point and its axis (0: x, 1: y, 2: z)
+    struct Edge{
+        Vector3u node;
+        int axis;
+    };
 private:
-    Grid const& mGrid;
-    OpenGP::SurfaceMesh& mMesh;
-    OpenGP::Scalar mIsoVal;
-    std::map<unsigned long int, OpenGP::SurfaceMesh::Vertex> mEdge2Vertex;
     static int edgeTable[256];
     static int triTable[256][17];
     
 public:
-    static void exec(const Grid& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval = 0);
-    MarchingCubes(const Grid& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval = 0);
+    /// Dense grids: slab-parallel extraction, edge vertices are shared through flat
+    /// per-plane arrays (no map, no resolution limit) and the mesh is built in bulk.
+    /// If given, "edges" receives the grid edge of every vertex (indexed by vertex id)
+    static void exec(const Grid& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval = 0,
+                     std::vector<Edge>* edges = nullptr);
+    /// Sparse grids: only cubes whose 8 corners lie in active bricks are processed.
+    /// Brick-parallel, edge vertices are shared through flat per-brick arrays
+    static void exec(const SparseGrid& grid, OpenGP::SurfaceMesh& mesh, OpenGP::Scalar isoval = 0);
 
 private:
-    void processCube(unsigned int x, unsigned int y, unsigned int z);
-    OpenGP::SurfaceMesh::Vertex addVertex(Vector3u const& p0, Vector3u const& p1);
+    struct Slab;
+    static void processSlab(const Grid& grid, OpenGP::Scalar isoval, unsigned int x0, unsigned int x1, Slab& slab);
 };
 
 //=============================================================================
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <unordered_map>
+#include <OpenGP/types.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Adaptive sampling of an implicit function: cells are only refined where the
+/// corner signs or distance values indicate a nearby surface, so large empty
+/// regions stay coarse. Cells live on a dyadic lattice of 2^max_depth cells per
+/// side; corners are identified by their (finest) lattice coordinates and their
+/// values are stored once, in a hash map shared by all the cells touching them.
+class Octree{
+public:
+    typedef Eigen::Matrix<unsigned int, 3, 1> Vector3u;
+    struct Cell{
+        Vector3u min;        ///< first corner (finest lattice coordinates)
+        unsigned int depth;
+        int children;        ///< first of the 8 consecutive children, -1 for leaves
+        Cell(const Vector3u& min, unsigned int depth) : min(min), depth(depth), children(-1){}
+    };
+    /// Corner (or child) i is at offset ((i>>2)&1, (i>>1)&1, i&1), i.e. bit (4>>axis)
+    static Vector3u offset(int i){ return Vector3u((i >> 2) & 1, (i >> 1) & 1, i & 1); }
+
+private:
+    Vec3 mOrigin;
+    Scalar mH;                 ///< finest cell size
+    unsigned int mMaxDepth;
+    std::vector<Cell> mCells;  ///< mCells[0] is the root
+    std::unordered_map<uint64_t, Scalar> mValues;
+
+    static uint64_t key(const Vector3u& p){
+        return uint64_t(p[0]) | (uint64_t(p[1]) << 21) | (uint64_t(p[2]) << 42);
+    }
+
+public:
+    /// The box is expected to be a cube (see bbox_cubified)
+    Octree(const Box3& box, unsigned int max_depth) :
+        mOrigin(box.min()), mMaxDepth(max_depth)
+    {
+        mH = (box.max() - box.min()).maxCoeff() / Scalar(1u << max_depth);
+        mCells.push_back(Cell(Vector3u::Zero(), 0));
+    }
+
+    unsigned int max_depth() const { return mMaxDepth; }
+    /// Finest cell size
+    Scalar h() const { return mH; }
+    const std::vector<Cell>& cells() const { return mCells; }
+    /// Side of a cell, in finest cells
+    unsigned int size(const Cell& cell) const { return 1u << (mMaxDepth - cell.depth); }
+    Vector3u corner(const Cell& cell, int i) const { return cell.min + offset(i) * size(cell); }
+    Vec3 point(const Vector3u& p) const { return mOrigin + mH * p.cast<Scalar>(); }
+    /// Value at a corner of a cell
+    Scalar value(const Vector3u& p) const{
+        auto it = mValues.find(key(p));
+        assert(it != mValues.end());
+        return it->second;
+    }
+
+    /// Leaf containing the point of coordinates p2 in half finest cells (-1 if outside)
+    int locate(const Eigen::Vector3i& p2) const{
+        int extent = 2 << mMaxDepth;
+        for(int d = 0; d < 3; ++d)
+            if(p2[d] < 0 || p2[d] >= extent) return -1;
+        int id = 0;
+        while(mCells[id].children >= 0){
+            const Cell& cell = mCells[id];
+            int half = size(cell) / 2;
+            int child = 0;
+            for(int d = 0; d < 3; ++d)
+                if(p2[d] >= 2 * int(cell.min[d] + half)) child |= 4 >> d;
+            id = cell.children + child;
+        }
+        return id;
+    }
+
+    /// Builds the tree breadth first: all cells are refined up to min_depth, then only
+    /// those with a sign change or a corner closer to the isosurface than the cell
+    /// diagonal. Corner values of a level are evaluated in parallel, the implicit
+    /// (eval_implicit_at, as in GridSampler) must be safe to call concurrently.
+    template <class Implicit>
+    void build(const Implicit& implicit, unsigned int min_depth, Scalar isoval = 0){
+        mCells.erase(mCells.begin() + 1, mCells.end());
+        mCells[0].children = -1;
+        mValues.clear();
+
+        std::vector<int> level(1, 0);
+        for(unsigned int depth = 0; !level.empty(); ++depth){
+            // evaluate the corners not shared with previous levels
+            std::vector<Vector3u> missing;
+            for(int id : level)
+                for(int i = 0; i < 8; ++i){
+                    Vector3u p = corner(mCells[id], i);
+                    if(mValues.insert(std::make_pair(key(p), Scalar(0))).second)
+                        missing.push_back(p);
+                }
+            std::vector<Scalar> values(missing.size());
+            #pragma omp parallel for schedule(dynamic, 256)
+            for(int i = 0; i < (int) missing.size(); ++i)
+                values[i] = implicit.eval_implicit_at( point(missing[i]) );
+            for(size_t i = 0; i < missing.size(); ++i)
+                mValues[key(missing[i])] = values[i];
+
+            if(depth == mMaxDepth) break;
+
+            // refine the cells close to the surface
+            Scalar diagonal = mH * (1u << (mMaxDepth - depth)) * std::sqrt(Scalar(3));
+            std::vector<int> next;
+            for(int id : level){
+                if(depth >= min_depth && !near_surface(mCells[id], diagonal, isoval))
+                    continue;
+                Vector3u min = mCells[id].min;
+                unsigned int half = size(mCells[id]) / 2;
+                mCells[id].children = (int) mCells.size();
+                for(int c = 0; c < 8; ++c){
+                    next.push_back((int) mCells.size());
+                    mCells.push_back(Cell(min + offset(c) * half, depth + 1));
+                }
+            }
+            level.swap(next);
+        }
+    }
+
+private:
+    bool near_surface(const Cell& cell, Scalar diagonal, Scalar isoval) const{
+        bool inside = value(corner(cell, 0)) > isoval;
+        for(int i = 0; i < 8; ++i){
+            Scalar v = value(corner(cell, i));
+            if((v > isoval) != inside || std::fabs(v - isoval) < diagonal)
+                return true;
+        }
+        return false;
+    }
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,156 @@
+#include "RBFTreecode.h"
+#include <algorithm>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+RBFTreecode::RBFTreecode(const Mat3xN& centers, int leaf_size, double theta) :
+    mLeafSize(leaf_size), mTheta(theta)
+{
+    int n = centers.cols();
+    mPoints.resize(n);
+    mOrder.resize(n);
+    for(int i = 0; i < n; ++i){
+        mPoints[i] = centers.col(i).cast<double>();
+        mOrder[i] = i;
+    }
+    mNodes.reserve(2 * (n / std::max(1, leaf_size)) + 1);
+    if(n > 0) build(0, n);
+
+    // points in tree order, so that leaves are contiguous
+    std::vector<Vec3d> points(n);
+    for(int i = 0; i < n; ++i)
+        points[i] = mPoints[mOrder[i]];
+    mPoints.swap(points);
+    mWeights.assign(n, 0.0);
+}
+
+int RBFTreecode::build(int begin, int end){
+    int id = (int) mNodes.size();
+    mNodes.push_back(Node());
+
+    // bounding box, split at the median of its largest extent
+    Vec3d lo = mPoints[mOrder[begin]], hi = lo;
+    for(int i = begin; i < end; ++i){
+        lo = lo.cwiseMin(mPoints[mOrder[i]]);
+        hi = hi.cwiseMax(mPoints[mOrder[i]]);
+    }
+    Vec3d center = (lo + hi) / 2;
+    double radius = 0;
+    for(int i = begin; i < end; ++i)
+        radius = std::max(radius, (mPoints[mOrder[i]] - center).norm());
+
+    int children[2] = {-1, -1};
+    if(end - begin > mLeafSize){
+        int axis;
+        (hi - lo).maxCoeff(&axis);
+        int mid = (begin + end) / 2;
+        std::nth_element(mOrder.begin() + begin, mOrder.begin() + mid, mOrder.begin() + end,
+                         [&](int a, int b){ return mPoints[a][axis] < mPoints[b][axis]; });
+        children[0] = build(begin, mid);
+        children[1] = build(mid, end);
+    }
+
+    Node& node = mNodes[id];
+    node.center = center;
+    node.radius = radius;
+    node.begin = begin;
+    node.end = end;
+    node.children[0] = children[0];
+    node.children[1] = children[1];
+    return id;
+}
+
+void RBFTreecode::set_weights(const Eigen::VectorXd& weights){
+    for(size_t i = 0; i < mOrder.size(); ++i)
+        mWeights[i] = weights(mOrder[i]);
+
+    #pragma omp parallel for schedule(dynamic, 16)
+    for(int id = 0; id < (int) mNodes.size(); ++id){
+        Node& node = mNodes[id];
+        Moments m;
+        m.W = m.B = 0;
+        m.D.setZero();
+        m.Q.setZero();
+        std::fill(m.M, m.M + 6, 0.0);
+        std::fill(m.O, m.O + 10, 0.0);
+        for(int i = node.begin; i < node.end; ++i){
+            double w = mWeights[i];
+            Vec3d d = mPoints[i] - node.center;
+            double x = d.x(), y = d.y(), z = d.z();
+            double sq = d.squaredNorm();
+            m.W += w;
+            m.D += w * d;
+            m.B += w * sq;
+            m.Q += (w * sq) * d;
+            m.M[0] += w*x*x; m.M[1] += w*y*y; m.M[2] += w*z*z;
+            m.M[3] += w*x*y; m.M[4] += w*x*z; m.M[5] += w*y*z;
+            m.O[0] += w*x*x*x; m.O[1] += w*y*y*y; m.O[2] += w*z*z*z;
+            m.O[3] += w*x*x*y; m.O[4] += w*x*x*z; m.O[5] += w*y*y*x;
+            m.O[6] += w*y*y*z; m.O[7] += w*z*z*x; m.O[8] += w*z*z*y;
+            m.O[9] += w*x*y*z;
+        }
+        node.moments = m;
+    }
+}
+
+double RBFTreecode::eval(const Vec3d& p) const{
+    return mNodes.empty() ? 0.0 : eval(p, 0);
+}
+
+double RBFTreecode::eval(const Vec3d& p, int id) const{
+    const Node& node = mNodes[id];
+    Vec3d r = p - node.center;
+    double rho = r.norm();
+
+    if(node.radius < mTheta * rho){
+        // far field: |r - delta|^3 = rho^3 - 3 rho^2 (u.delta) + 3/2 rho (|delta|^2 + (u.delta)^2)
+        //                            - 3/2 (u.delta) |delta|^2 + 1/2 (u.delta)^3 + O(|delta|^4 / rho)
+        const Moments& m = node.moments;
+        Vec3d u = r / rho;
+        double x = u.x(), y = u.y(), z = u.z();
+        double uMu = x*x*m.M[0] + y*y*m.M[1] + z*z*m.M[2]
+                   + 2 * (x*y*m.M[3] + x*z*m.M[4] + y*z*m.M[5]);
+        double uO = x*x*x*m.O[0] + y*y*y*m.O[1] + z*z*z*m.O[2]
+                  + 3 * (x*x*y*m.O[3] + x*x*z*m.O[4] + y*y*x*m.O[5]
+                       + y*y*z*m.O[6] + z*z*x*m.O[7] + z*z*y*m.O[8])
+                  + 6 * x*y*z*m.O[9];
+        return m.W * rho*rho*rho - 3 * rho*rho * u.dot(m.D) + 1.5 * rho * (m.B + uMu)
+             - 1.5 * u.dot(m.Q) + 0.5 * uO;
+    }
+
+    if(node.children[0] < 0){
+        double value = 0;
+        for(int i = node.begin; i < node.end; ++i)
+            value += mWeights[i] * kernel(p, mPoints[i]);
+        return value;
+    }
+    return eval(p, node.children[0]) + eval(p, node.children[1]);
+}
+
+void RBFTreecode::eval(const Eigen::Ref<const Mat3xN>& points, Eigen::VectorXd& values) const{
+    values.resize(points.cols());
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(int i = 0; i < (int) points.cols(); ++i)
+        values(i) = eval(Vec3d(points.col(i).cast<double>()));
+}
+
+void RBFTreecode::eval_at_centers(Eigen::VectorXd& values) const{
+    values.resize(mPoints.size());
+    #pragma omp parallel for schedule(dynamic, 256)
+    for(int i = 0; i < (int) mPoints.size(); ++i)
+        values(mOrder[i]) = eval(mPoints[i]);
+}
+
+std::vector<std::vector<int>> RBFTreecode::leaves() const{
+    std::vector<std::vector<int>> leaves;
+    for(const Node& node : mNodes)
+        if(node.children[0] < 0)
+            leaves.push_back(std::vector<int>(mOrder.begin() + node.begin, mOrder.begin() + node.end));
+    return leaves;
+}
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
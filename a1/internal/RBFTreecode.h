@@ -0,0 +1,68 @@
+#pragma once
+#include <vector>
+#include <OpenGP/types.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Hierarchical evaluation of s(x) = sum_i w_i |x - c_i|^3 (the triharmonic RBF).
+/// The centers are clustered in a binary tree; a cluster of radius R seen from
+/// distance d > R/theta is replaced by the Taylor expansion of its kernels about
+/// the cluster center, truncated after the third order (relative error ~theta^4).
+/// Closer clusters are opened, leaves are summed directly. Evaluation is then
+/// O(log n) per query instead of O(n). Internally in double precision.
+class RBFTreecode{
+public:
+    typedef Eigen::Vector3d Vec3d;
+private:
+    /// Weighted moments of the offsets delta_i = c_i - center of a cluster
+    struct Moments{
+        double W;       ///< sum w
+        Vec3d D;        ///< sum w delta
+        double B;       ///< sum w |delta|^2
+        double M[6];    ///< sum w delta delta^T (xx yy zz xy xz yz)
+        Vec3d Q;        ///< sum w |delta|^2 delta
+        double O[10];   ///< sum w delta^(x)3 (xxx yyy zzz xxy xxz yyx yyz zzx zzy xyz)
+    };
+    struct Node{
+        Vec3d center;
+        double radius;
+        int begin, end;       ///< range in mOrder
+        int children[2];      ///< -1 for leaves
+        Moments moments;
+    };
+    std::vector<Vec3d> mPoints;   ///< centers, in tree order
+    std::vector<int> mOrder;      ///< tree order -> center index
+    std::vector<double> mWeights; ///< in tree order
+    std::vector<Node> mNodes;     ///< mNodes[0] is the root
+    int mLeafSize;
+    double mTheta;
+
+public:
+    RBFTreecode(const Mat3xN& centers, int leaf_size = 32, double theta = 0.5);
+
+    /// Sets the weights (indexed like the centers) and updates the cluster moments
+    void set_weights(const Eigen::VectorXd& weights);
+    /// s(p)
+    double eval(const Vec3d& p) const;
+    /// s at each column of "points" (in parallel)
+    void eval(const Eigen::Ref<const Mat3xN>& points, Eigen::VectorXd& values) const;
+    /// s at the centers, i.e. the product of the RBF matrix with the weights
+    void eval_at_centers(Eigen::VectorXd& values) const;
+
+    /// Center indices of each leaf (spatially coherent blocks, e.g. for preconditioning)
+    std::vector<std::vector<int>> leaves() const;
+
+private:
+    int build(int begin, int end);
+    double eval(const Vec3d& p, int node) const;
+    static double kernel(const Vec3d& x, const Vec3d& c){
+        double r = (x - c).norm();
+        return r*r*r;
+    }
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -0,0 +1,120 @@
+#pragma once
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <algorithm>
+#include <unordered_map>
+#include <OpenGP/types.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+
+//=============================================================================
+namespace OpenGP {
+//=============================================================================
+
+/// Sparse version of Grid: the same lattice of xres*yres*zres points, but values
+/// are only stored in the bricks (BRICK^3 points) that have been activated, e.g.
+/// those within a narrow band of the input samples. Memory and work are then
+/// proportional to the surface area rather than the volume.
+class SparseGrid{
+public:
+    typedef Eigen::Matrix<unsigned int, 3, 1> Vector3u;
+    static const unsigned int BRICK = 8;                     ///< brick side (grid points)
+    static const unsigned int BRICK_SIZE = BRICK*BRICK*BRICK; ///< values per brick
+private:
+    Vec3 mOrigin;
+    Vec3 mDx, mDy, mDz;
+    unsigned int mXRes, mYRes, mZRes;
+    std::unordered_map<uint64_t, int> mBrickIndex; ///< brick coordinates -> brick id
+    std::vector<Vector3u> mBricks;                 ///< brick id -> brick coordinates
+    std::vector<Scalar> mValues;                   ///< BRICK_SIZE values per brick, z-fastest
+
+    static uint64_t key(unsigned int bx, unsigned int by, unsigned int bz){
+        return uint64_t(bx) | (uint64_t(by) << 21) | (uint64_t(bz) << 42);
+    }
+
+public:
+    SparseGrid(const Box3& box, uint xres, uint yres, uint zres) :
+        mOrigin(box.min()), mXRes(xres), mYRes(yres), mZRes(zres)
+    {
+        Vec3 size = box.max() - box.min();
+        mDx = Vec3(size.x(), 0, 0) / (float)(xres - 1);
+        mDy = Vec3(0, size.y(), 0) / (float)(yres - 1);
+        mDz = Vec3(0, 0, size.z()) / (float)(zres - 1);
+    }
+
+    unsigned int xResolution() const { return mXRes; }
+    unsigned int yResolution() const { return mYRes; }
+    unsigned int zResolution() const { return mZRes; }
+
+    Vec3 point(unsigned int x, unsigned int y, unsigned int z) const{
+        return mOrigin + mDx * x + mDy * y + mDz * z;
+    }
+    Vec3 point(Vector3u const& xyz) const{
+        return point(xyz[0], xyz[1], xyz[2]);
+    }
+
+/// @{ bricks
+public:
+    /// Activates the bricks covering the cells of the given points, dilated by "band" grid points
+    void activate(const Mat3xN& points, unsigned int band){
+        Vector3u bmax((mXRes - 1) / BRICK, (mYRes - 1) / BRICK, (mZRes - 1) / BRICK);
+        Vec3 h(mDx.x(), mDy.y(), mDz.z());
+        for(int i = 0; i < points.cols(); ++i){
+            Vec3 cell = ((points.col(i) - mOrigin).array() / h.array()).floor();
+            Vector3u lo, hi;
+            for(int d = 0; d < 3; ++d){
+                lo[d] = std::min<int>(std::max<int>(int(cell[d]) - int(band), 0) / BRICK, bmax[d]);
+                hi[d] = std::min<int>(std::max<int>(int(cell[d]) + 1 + int(band), 0) / BRICK, bmax[d]);
+            }
+            for(unsigned int bx = lo[0]; bx <= hi[0]; ++bx)
+                for(unsigned int by = lo[1]; by <= hi[1]; ++by)
+                    for(unsigned int bz = lo[2]; bz <= hi[2]; ++bz)
+                        activate_brick(bx, by, bz);
+        }
+    }
+
+    /// Activates (allocates) a single brick, returns its id
+    int activate_brick(unsigned int bx, unsigned int by, unsigned int bz){
+        auto inserted = mBrickIndex.insert(std::make_pair(key(bx, by, bz), (int)mBricks.size()));
+        if(inserted.second){
+            mBricks.push_back(Vector3u(bx, by, bz));
+            mValues.resize(mValues.size() + BRICK_SIZE, 0.0f);
+        }
+        return inserted.first->second;
+    }
+
+    int n_bricks() const { return (int) mBricks.size(); }
+    /// Coordinates of brick (its first grid point is BRICK*coordinates)
+    Vector3u const& brick(int id) const { return mBricks[id]; }
+    /// Values of a brick, BRICK_SIZE of them, z-fastest
+    Scalar* brick_values(int id){ return mValues.data() + size_t(id) * BRICK_SIZE; }
+    const Scalar* brick_values(int id) const{ return mValues.data() + size_t(id) * BRICK_SIZE; }
+    /// Id of the brick at the given brick coordinates, -1 if not active
+    int find_brick(unsigned int bx, unsigned int by, unsigned int bz) const{
+        auto it = mBrickIndex.find(key(bx, by, bz));
+        return (it == mBrickIndex.end()) ? -1 : it->second;
+    }
+    /// Offset of grid point xyz within its brick
+    static unsigned int brick_offset(Vector3u const& xyz){
+        return (xyz[2] % BRICK) + (xyz[1] % BRICK) * BRICK + (xyz[0] % BRICK) * BRICK * BRICK;
+    }
+/// @}
+
+/// @{ random access (hash lookup, prefer per-brick access in loops)
+public:
+    bool has(Vector3u const& xyz) const{
+        return find_brick(xyz[0] / BRICK, xyz[1] / BRICK, xyz[2] / BRICK) >= 0;
+    }
+    /// value at xyz, which must lie in an active brick
+    Scalar operator()(Vector3u const& xyz) const{
+        int id = find_brick(xyz[0] / BRICK, xyz[1] / BRICK, xyz[2] / BRICK);
+        assert(id >= 0);
+        return brick_values(id)[brick_offset(xyz)];
+    }
+/// @}
+};
+
+//=============================================================================
+} // namespace OpenGP
+//=============================================================================
@@ -1,5 +1,6 @@
 #include "SurfaceMeshVerticesKDTree.h"
 #include <vector>
+#include <algorithm>
 #include <OpenGP/types.h>
 #include <OpenGP/SurfaceMesh/Eigen.h>
 #include <OpenGP/external/nanoflann/nanoflann.hpp>
@@ -34,6 +35,19 @@ public:
         resultSet.init(out_indices, out_distances_sq);
         index->findNeighbors(resultSet, query_point, nanoflann::SearchParams());
     }
+    /// As query(), but only points closer than sq_bound are considered (the bound prunes the
+    /// descent from the start); returns how many were found, which is < num_closest if the bound was too tight.
+    inline size_t bounded_query(const num_t *query_point, const size_t num_closest, const num_t sq_bound, IndexType *out_indices, num_t *out_distances_sq) const {
+        nanoflann::KNNResultSet<typename MatrixType::Scalar,IndexType> resultSet(num_closest);
+        resultSet.init(out_indices, out_distances_sq);
+        out_distances_sq[num_closest-1] = sq_bound; ///< initial worstDist()
+        index->findNeighbors(resultSet, query_point, nanoflann::SearchParams());
+        return resultSet.size();
+    }
+    /// Query for all points within sq_radius of a given point (entered as query_point[0:dim-1]), sorted by distance.
+    inline size_t radius_query(const num_t *query_point, const num_t sq_radius, std::vector<std::pair<IndexType,num_t> >& out) const {
+        return index->radiusSearch(query_point, sq_radius, out, nanoflann::SearchParams());
+    }
     /// Query for the closest points to a given point (entered as query_point[0:dim-1]).
     inline IndexType closest(const num_t *query_point) const {
         IndexType out_indices;
@@ -62,19 +76,32 @@ public:
 };
 
 
-/// Slight specialization of adapter above to Mat3xN & L2 norms
-class NanoflannAdapter : public KDTreeNanoflann<Mat3xN, 3, nanoflann::metric_L2_Simple>{
+/// Slight specialization of adapter above to (mapped) 3xN vertices & L2 norms
+class NanoflannAdapter : public KDTreeNanoflann<VerticesMatrixMap, 3, nanoflann::metric_L2_Simple>{
 public:
-    typedef KDTreeNanoflann<Mat3xN, 3, nanoflann::metric_L2_Simple> Super;
-    NanoflannAdapter(const Mat3xN&mat, const int leaf_max_size = 10) : 
+    typedef KDTreeNanoflann<VerticesMatrixMap, 3, nanoflann::metric_L2_Simple> Super;
+    NanoflannAdapter(const VerticesMatrixMap& mat, const int leaf_max_size = 10) :
         Super(mat, leaf_max_size){}
 };
 
-SurfaceMeshVerticesKDTree::SurfaceMeshVerticesKDTree(SurfaceMesh &mesh){ 
+SurfaceMeshVerticesKDTree::SurfaceMeshVerticesKDTree(SurfaceMesh &mesh, Storage storage) :
+    _mesh(mesh), _storage(storage){
     assert(_adapter == nullptr);
-    // TODO: can we avoid creating a memory duplicate?
-    _data = vertices_matrix(mesh);
-    _adapter = new NanoflannAdapter(_data); 
+    rebuild();
+}
+
+void SurfaceMeshVerticesKDTree::rebuild(){
+    // a new map (the "v:point" storage might have been re-allocated) and a new index
+    // over it; the index holds a reference to the map, so both are replaced together
+    delete _adapter;
+    _adapter = nullptr;
+    if(_storage == COPY){
+        _data = vertices_matrix(_mesh);
+        _points.reset(new VerticesMatrixMap(_data.data(), 3, _data.cols()));
+    } else {
+        _points.reset(new VerticesMatrixMap(vertices_matrix(_mesh)));
+    }
+    _adapter = new NanoflannAdapter(*_points);
 }
 
 SurfaceMeshVerticesKDTree::~SurfaceMeshVerticesKDTree(){ 
@@ -86,7 +113,7 @@ SurfaceMesh::Vertex SurfaceMeshVerticesKDTree::closest_vertex(const Vec3 &p) con
     return SurfaceMesh::Vertex(midx);
 }
 
-std::vector<SurfaceMesh::Vertex> SurfaceMeshVerticesKDTree::kNN(const Vec3 &p,int N){
+std::vector<SurfaceMesh::Vertex> SurfaceMeshVerticesKDTree::kNN(const Vec3 &p,int N) const{
     std::vector<int> indxs(N,0);
     std::vector<Scalar> dists(N,0);
     _adapter->query( p.data(), N, indxs.data(), dists.data() );
@@ -96,6 +123,114 @@ std::vector<SurfaceMesh::Vertex> SurfaceMeshVerticesKDTree::kNN(const Vec3 &p,in
     return verts;
 }
 
+void SurfaceMeshVerticesKDTree::kNN(const Vec3& p, int N, int* indices, Scalar* sq_distances) const{
+    _adapter->query( p.data(), N, indices, sq_distances );
+}
+
+int SurfaceMeshVerticesKDTree::kNN(const Vec3& p, int N, int* indices, Scalar* sq_distances, Scalar sq_bound) const{
+    return (int) _adapter->bounded_query( p.data(), N, sq_bound, indices, sq_distances );
+}
+
+void SurfaceMeshVerticesKDTree::closest_vertices(const Eigen::Ref<const Mat3xN>& queries, int* indices) const{
+    int n = queries.cols();
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i<n; ++i){
+        indices[i] = _adapter->closest( queries.col(i).data() );
+    }
+}
+
+void SurfaceMeshVerticesKDTree::kNNs(const Eigen::Ref<const Mat3xN>& queries, int N, int* indices, Scalar* sq_distances) const{
+    int n = queries.cols();
+    #pragma omp parallel for schedule(static)
+    for(int i=0; i<n; ++i){
+        _adapter->query( queries.col(i).data(), N, indices + (size_t)i*N, sq_distances + (size_t)i*N );
+    }
+}
+
+void SurfaceMeshVerticesKDTree::kNNs(const Eigen::Ref<const Mat3xN>& queries, int N, IndicesMatrix& indices, MatMxN& sq_distances) const{
+    indices.resize(N, queries.cols());
+    sq_distances.resize(N, queries.cols());
+    kNNs(queries, N, indices.data(), sq_distances.data());
+}
+
+void SurfaceMeshVerticesKDTree::radius_search(const Vec3& p, Scalar radius, std::vector<std::pair<int,Scalar>>& neighbors) const{
+    // note: metric_L2_Simple works with squared distances
+    _adapter->radius_query( p.data(), radius*radius, neighbors );
+}
+
+void SurfaceMeshVerticesKDTree::radius_search(const Eigen::Ref<const Mat3xN>& queries, Scalar radius, Neighborhoods& out,
+                                              int min_neighbors, int max_neighbors) const{
+    // Queries are processed in blocks, each block gathers its results locally;
+    // blocks are then concatenated (in order) into the CSR arrays.
+    struct Block{
+        std::vector<int> counts;
+        std::vector<std::pair<int,Scalar>> neighbors;
+    };
+    const int block_size = 4096;
+    int n = queries.cols();
+    int n_blocks = (n + block_size - 1) / block_size;
+    std::vector<Block> blocks(n_blocks);
+
+    #pragma omp parallel
+    {
+        std::vector<std::pair<int,Scalar>> found;
+        std::vector<int> knn_indices(min_neighbors);
+        std::vector<Scalar> knn_sq_dists(min_neighbors);
+
+        #pragma omp for schedule(dynamic)
+        for(int b=0; b<n_blocks; ++b){
+            Block& block = blocks[b];
+            int end = std::min(n, (b+1)*block_size);
+            for(int i=b*block_size; i<end; ++i){
+                const Scalar* p = queries.col(i).data();
+                _adapter->radius_query( p, radius*radius, found );
+                if((int)found.size() < min_neighbors){
+                    // too sparse: fall back to the nearest neighbors
+                    int k = std::min(min_neighbors, (int)_points->cols());
+                    _adapter->query( p, k, knn_indices.data(), knn_sq_dists.data() );
+                    found.resize(k);
+                    for(int j=0; j<k; ++j)
+                        found[j] = std::make_pair(knn_indices[j], knn_sq_dists[j]);
+                }
+                if(max_neighbors > 0 && (int)found.size() > max_neighbors)
+                    found.resize(max_neighbors); ///< sorted, keeps the closest
+                block.counts.push_back(found.size());
+                block.neighbors.insert(block.neighbors.end(), found.begin(), found.end());
+            }
+        }
+    }
+
+    // prefix sum of the neighborhood sizes
+    out.offsets.resize(n+1);
+    out.offsets[0] = 0;
+    int i = 0;
+    std::vector<int> block_offsets(n_blocks);
+    for(int b=0; b<n_blocks; ++b){
+        block_offsets[b] = out.offsets[i];
+        for(int count: blocks[b].counts){
+            out.offsets[i+1] = out.offsets[i] + count;
+            ++i;
+        }
+    }
+
+    // scatter block results
+    out.indices.resize(out.offsets[n]);
+    out.sq_distances.resize(out.offsets[n]);
+    #pragma omp parallel for schedule(static)
+    for(int b=0; b<n_blocks; ++b){
+        int offset = block_offsets[b];
+        for(const auto& neighbor: blocks[b].neighbors){
+            out.indices[offset] = neighbor.first;
+            out.sq_distances[offset] = neighbor.second;
+            ++offset;
+        }
+    }
+}
+
+void SurfaceMeshVerticesKDTree::radius_search(Scalar radius, Neighborhoods& out, int min_neighbors, int max_neighbors) const{
+    radius_search(*_points, radius, out, min_neighbors, max_neighbors);
+}
+
 //=============================================================================
 } // namespace OpenGP
 //=============================================================================
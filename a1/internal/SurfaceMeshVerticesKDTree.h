@@ -1,22 +1,81 @@
 #pragma once
+#include <memory>
 #include <OpenGP/types.h>
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include <OpenGP/SurfaceMesh/eigen.h>
 
 //=============================================================================
 namespace OpenGP {
 //=============================================================================
 
+/// Neighbour indices, one column per query point
+typedef Eigen::Matrix<int, Eigen::Dynamic, Eigen::Dynamic> IndicesMatrix;
+
+/// Variable-size neighborhoods in CSR layout: the neighbors of query i are
+/// indices[offsets[i]] ... indices[offsets[i+1]-1], sorted by distance
+struct Neighborhoods{
+    std::vector<int> offsets = std::vector<int>(1, 0);
+    std::vector<int> indices;
+    std::vector<Scalar> sq_distances;
+
+    int size() const { return (int) offsets.size() - 1; }
+    int n_neighbors(int i) const { return offsets[i+1] - offsets[i]; }
+    const int* neighbors(int i) const { return indices.data() + offsets[i]; }
+    const Scalar* sq_distances_of(int i) const { return sq_distances.data() + offsets[i]; }
+};
+
 class NanoflannAdapter;
 class SurfaceMeshVerticesKDTree{
+public:
+    /// COPY indexes a private copy of the vertices, IN_PLACE indexes the "v:point"
+    /// storage of the mesh directly (no duplicate, but call rebuild() whenever
+    /// vertices are moved/added)
+    enum Storage{ COPY, IN_PLACE };
+private:
     NanoflannAdapter* _adapter = nullptr; ///< internal
-    Mat3xN _data;
+    SurfaceMesh& _mesh;
+    Storage _storage;
+    Mat3xN _data;                         ///< only used by COPY
+    std::unique_ptr<VerticesMatrixMap> _points; ///< what the index sees (_data or "v:point"), replaced with the index
 public:
-    SurfaceMeshVerticesKDTree(SurfaceMesh& mesh);
+    SurfaceMeshVerticesKDTree(SurfaceMesh& mesh, Storage storage = COPY);
+    SurfaceMeshVerticesKDTree(const SurfaceMeshVerticesKDTree&) = delete; ///< index refers to *_points
     ~SurfaceMeshVerticesKDTree();
+    /// Re-reads the vertex positions and rebuilds the index
+    void rebuild();
     /// Find the closest neighbor to "p"
     SurfaceMesh::Vertex closest_vertex(const Vec3& p) const;
     /// Finds the k nearest neighbors to "p"
-    std::vector<SurfaceMesh::Vertex> kNN(const Vec3 &p, int N);
+    std::vector<SurfaceMesh::Vertex> kNN(const Vec3 &p, int N) const;
+    /// Finds the k nearest neighbors to "p" writing into caller-provided buffers (thread-safe)
+    void kNN(const Vec3& p, int N, int* indices, Scalar* sq_distances) const;
+    /// As above, only among the vertices closer than sqrt(sq_bound) to "p"; returns the number
+    /// found (< N when the bound holds fewer vertices). A known upper bound on the N-th
+    /// distance (e.g. from a nearby query) lets the search skip most of the tree.
+    int kNN(const Vec3& p, int N, int* indices, Scalar* sq_distances, Scalar sq_bound) const;
+
+/// @{ batch queries, parallel over the columns of "queries" (thread-safe)
+public:
+    /// Closest vertex of each query; "indices" holds queries.cols() entries
+    void closest_vertices(const Eigen::Ref<const Mat3xN>& queries, int* indices) const;
+    /// k nearest neighbors of each query; buffers hold N*queries.cols() entries (column-major, N per query)
+    void kNNs(const Eigen::Ref<const Mat3xN>& queries, int N, int* indices, Scalar* sq_distances) const;
+    /// As above, (re)sizing the outputs to N x queries.cols() only when needed
+    void kNNs(const Eigen::Ref<const Mat3xN>& queries, int N, IndicesMatrix& indices, MatMxN& sq_distances) const;
+/// @}
+
+/// @{ fixed-radius queries
+public:
+    /// All vertices within "radius" of "p" as (index, squared distance), sorted by distance
+    void radius_search(const Vec3& p, Scalar radius, std::vector<std::pair<int,Scalar>>& neighbors) const;
+    /// Radius neighborhoods of each query (parallel over queries). Neighborhoods with
+    /// fewer than "min_neighbors" fall back to the min_neighbors nearest neighbors, those
+    /// with more than "max_neighbors" (if >0) keep the closest ones only.
+    void radius_search(const Eigen::Ref<const Mat3xN>& queries, Scalar radius, Neighborhoods& out,
+                       int min_neighbors = 0, int max_neighbors = 0) const;
+    /// As above, querying every indexed vertex
+    void radius_search(Scalar radius, Neighborhoods& out, int min_neighbors = 0, int max_neighbors = 0) const;
+/// @}
 };
 
 //=============================================================================
@@ -4,13 +4,14 @@
 #include <OpenGP/SurfaceMesh/GL/SurfaceMeshRenderFlat.h>
 #include "ArcballWindow.h"
 #include "ReimannianGraph.h"
+#include "NormalEstimator.h"
+#include "reconstruct.h"
 #include "internal/SurfaceMeshVerticesKDTree.h"
 #include <stack>
 #include <queue>
 
 using namespace OpenGP;
 
-extern void reconstruct(SurfaceMesh& cloud, SurfaceMesh& output, uint resolution);
 
 // Configuration 
 // -------------
@@ -42,80 +43,34 @@ int main(int argc, char** argv){
 
 
 	//Setup SurfaceMesh properties
-	SurfaceMesh::Vertex_property<std::vector<SurfaceMesh::Vertex>> kNNs = point_cloud.add_vertex_property<std::vector<SurfaceMesh::Vertex>>("v:kNN");
-	SurfaceMesh::Vertex_property<Vec3>vplane_c = point_cloud.add_vertex_property<Vec3>("v:plane_c");
-	SurfaceMesh::Vertex_property<Vec3>vnormals = point_cloud.get_vertex_property<Vec3>("v:normal");
+	SurfaceMesh::Vertex_property<Vec3>vnormals = point_cloud.vertex_property<Vec3>("v:normal");
 
 	// Create KD Tree
-	SurfaceMeshVerticesKDTree accelerator = SurfaceMeshVerticesKDTree(point_cloud);
+	SurfaceMeshVerticesKDTree accelerator(point_cloud, SurfaceMeshVerticesKDTree::IN_PLACE);
 
-	// Loop over all point_cloud points
-	for (auto&& vertex : point_cloud.vertices()){
+	// Estimate (unoriented) normals from the kNN covariance matrices
+	NormalEstimator estimator(point_cloud, accelerator);
+	estimator.exec(K);
 
-		// Determine kNN
-		Vec3 pos = point_cloud.position(vertex);
-		std::vector<SurfaceMesh::Vertex> kNN = accelerator.kNN(pos, K);
-		kNNs[vertex] = kNN;
-
-		Vec3 center(0, 0, 0);
-
-		// Put kNN into a matrix
-		Eigen::MatrixXf kNN_mat(K, 3);
-		for (int i = 0; i < K; i++) {
-			Vec3 pos = point_cloud.position(kNN[i]);
-			center += pos; // keep track to compute center
-			kNN_mat.row(i) = pos;
-		}
-
-		//compute the center of the plane
-		center = center * (1.0 / (double)K);
-		vplane_c[vertex] = center;
-
-		// compute covariance matrix of kNN_mat in eigen (inspiration from http://stackoverflow.com/questions/15138634/eigen-is-there-an-inbuilt-way-to-calculate-sample-covariance)
-		Eigen::MatrixXf c = kNN_mat.rowwise() - kNN_mat.colwise().mean();
-		Eigen::Matrix3f cov = (c.adjoint() * c) / (double)(K - 1);
-
-		// Determine eigenvalues/vectors of covariance matrix
-		Eigen::EigenSolver<Eigen::MatrixXf> es(cov);
-		int idx;
-		es.eigenvalues().real().minCoeff(&idx);
-		Vec3 smallest_e = es.eigenvectors().real().col(idx);
-
-		// This point's normal is the smallest eigenvector
-		vnormals[vertex] = smallest_e;
-	}
-
-	// create a graph containing all vertices
-	Graph* g = new Graph(n_vertices);
-
-
-	float max_z = FLT_MIN;
+	float max_z = -FLT_MAX;
 	int v = -1; // this will be the anchor for traversal of MST (highest z value)
 	
-	// loop over vertices
+	// loop over vertices, determine the highest z value
 	for (const auto& vertex : point_cloud.vertices()) {
-
-		// determine the highest z value
 		if (point_cloud.position(vertex)[2] > max_z) {
 			max_z = point_cloud.position(vertex)[2];
 			v = vertex.idx();
 		}
-
-		// add weighted edge for each NN
-		for (const auto& kNN : kNNs[(SurfaceMesh::Vertex)vertex]) {
-			Vec3 n_i = vnormals[vertex];
-			Vec3 n_j = vnormals[kNN];
-			double weight = 1 - abs(n_i.dot(n_j));
-			if (vertex.idx() != kNN.idx()) g->addEdge(vertex.idx(), kNN.idx(), (float)weight);
-		}
-
 	}
 
+	// create the (sparse) Reimannian graph, one weighted edge per kNN
+	Graph g(estimator.kNNs(), vnormals);
+
 	//force to -z, as thats what makes the surface shading work
 	vnormals[SurfaceMesh::Vertex(v)] = Vec3(0, 0, -1);
 
 	// compute the MST and traverse DFS order
-	Graph* MST = g->MST();
+	Graph MST = g.MST();
 	std::stack<int> S;
 	S.push(v);
 	Vec3 last_normal = vnormals[SurfaceMesh::Vertex(v)];
@@ -147,8 +102,8 @@ int main(int argc, char** argv){
 			}
 
 			// stack up more vertices to visit in MST
-			for (int i = 0; i < n_vertices; i++) {
-				if (MST->at(v, i) > -1) {
+			for (int i : MST.neighbors(v)) {
+				if (!disc[i]) {
 					parent_of[i] = v;
 					S.push(i);
 				}
@@ -1,31 +1,79 @@
 #include <OpenGP/MLogger.h>
 #include <OpenGP/SurfaceMesh/bounding_box.h>
+#include <OpenGP/SurfaceMesh/eigen.h>
+#include <chrono>
+#include <algorithm>
+#include "reconstruct.h"
 #include "Grid.h"
+#include "SparseGrid.h"
+#include "GridSampler.h"
 #include "MarchingCubes.h"
+#include "Octree.h"
+#include "DualContouring.h"
 
 #include "ImplicitRBF.h"
 #include "ImplicitHoppe.h"
+#include "ImplicitPoU.h"
 
-void reconstruct(SurfaceMesh& cloud, SurfaceMesh &output, uint res){    
+void reconstruct(SurfaceMesh& cloud, SurfaceMesh &output, uint res, const ReconstructionParams& params){    
     // Compute bounding cube for Marching Cubes grid.
     mDebug() << "Computing bounding box\n";
     Box3 bbox = OpenGP::bounding_box(cloud);
     bbox = OpenGP::bbox_cubified(bbox);
     bbox = OpenGP::bbox_scaled(bbox, 1.1);        
 
-    // Setup marching cubes grid.
-    std::cout << "Setup regular grid for the signed distance field\n" << std::flush;
-    Grid grid(bbox, res, res, res);
-    
     // Uncomment the method you would like to employ
     ImplicitHoppe method(cloud);
+    // ImplicitHoppe method(cloud, 8);
     // ImplicitRBF method(cloud);
+    // ImplicitRBF method(cloud, ImplicitRBF::COMPACT);
+    // ImplicitRBF method(cloud, ImplicitRBF::TREECODE);
+    // ImplicitPoU method(cloud);
+    
+    if(params.sampling == ReconstructionParams::ADAPTIVE){
+        // Setup octree, its finest level has (at least) the requested resolution
+        std::cout << "Setup adaptive octree for the signed distance field\n" << std::flush;
+        unsigned int depth = 1;
+        while((1u << depth) + 1 < res) ++depth;
+        Octree octree(bbox, depth);
+
+        auto start = std::chrono::steady_clock::now();
+        octree.build(method, std::min(params.min_depth, depth));
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        mDebug("Sampled octree of depth %d (%d cells) in %.3fs", depth, (int) octree.cells().size(), elapsed.count());
+
+        std::cout << "Extract isosurface...\n";
+        DualContouring::exec(octree, method, output);
+        mDebug("Done! [#V:%d #F:%d]", output.n_vertices(), output.n_faces());
+        return;
+    }
+
+    if(params.sampling == ReconstructionParams::NARROW_BAND){
+        // Setup sparse grid, only bricks close to the samples are allocated
+        std::cout << "Setup narrow band grid for the signed distance field\n" << std::flush;
+        SparseGrid grid(bbox, res, res, res);
+        grid.activate(vertices_matrix(cloud), params.band);
+
+        auto start = std::chrono::steady_clock::now();
+        GridSampler::exec(grid, method);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        mDebug("Sampled %d bricks of %d^3 grid in %.3fs", grid.n_bricks(), res, elapsed.count());
+
+        std::cout << "Extract isosurface...\n";
+        MarchingCubes::exec(grid, output);
+        mDebug("Done! [#V:%d #F:%d]", output.n_vertices(), output.n_faces());
+        return;
+    }
+
+    // Setup marching cubes grid.
+    std::cout << "Setup regular grid for the signed distance field\n" << std::flush;
+    Grid grid(bbox, res, res, res);
     
     // Get grid's signed distance values by evaluating the implicit function
-    for(uint x=0; x < res; ++x)
-        for(uint y=0; y < res; ++y)
-            for(uint z=0; z < res; ++z)
-                grid(x, y, z) = method.eval_implicit_at( grid.point(x, y, z) );
+    auto start = std::chrono::steady_clock::now();
+    GridSampler::exec(grid, method);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    mDebug("Sampled %d^3 grid in %.3fs", res, elapsed.count());
     
     // Extracts isosurface by marching cubes
     std::cout << "Extract isosurface...\n";
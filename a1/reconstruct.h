@@ -0,0 +1,20 @@
+#pragma once
+#include <OpenGP/types.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+using namespace OpenGP;
+
+/// Options of the implicit surface reconstruction
+struct ReconstructionParams{
+    /// DENSE evaluates the implicit on every grid point, NARROW_BAND only on the
+    /// (8^3) bricks within "band" grid points of the input samples, ADAPTIVE on an
+    /// octree refined (from min_depth) down to the resolution where the surface is
+    enum Sampling{ DENSE, NARROW_BAND, ADAPTIVE };
+    Sampling sampling = DENSE;
+    unsigned int band = 2;
+    unsigned int min_depth = 3;
+};
+
+/// Reconstructs a mesh from an (oriented) point cloud on a res^3 grid
+void reconstruct(SurfaceMesh& cloud, SurfaceMesh& output, uint resolution,
+                 const ReconstructionParams& params = ReconstructionParams());
@@ -0,0 +1,270 @@
+/// Out-of-core reconstruction of oriented point clouds that do not fit in memory.
+///
+///     stream_reconstruct input.obj output.obj [-r res] [-t tile] [-o overlap] [-m method]
+///
+///   -r  resolution of the (virtual) global grid over the cloud, as in reconstruct() (256)
+///   -t  tile size, in grid cells (64)
+///   -o  tile overlap, in grid cells (4)
+///   -m  hoppe, hoppe<k> (e.g. hoppe8, see ImplicitHoppe), rbf, compact or treecode (hoppe)
+///
+/// The input needs one "vn" per "v" line (in any order). The cloud is streamed three
+/// times: for its bounding box, to partition it into overlapping tiles (binary files
+/// next to the output), and tile by tile: each tile is fitted independently, sampled on
+/// its part of the global grid and polygonized by Marching Cubes. Tiles share their
+/// boundary grid planes; the vertices on those planes are identified by the global grid
+/// edge they lie on and emitted once. The two tiles agree on a shared plane only if they
+/// see the same samples around it: with the Hoppe implicit, the seam is exact when the
+/// overlap is at least the distance from every node of the plane to its k-th nearest
+/// sample (the radius of its k-NN search), e.g. dense samples with respect to the grid.
+/// Sparser clouds, and the RBF fits (which depend on all the samples of a tile), leave
+/// seams that only agree approximately, possibly with cracks; the seam vertices placed
+/// differently by two tiles are counted and reported. Memory is bounded by one tile
+/// (plus the partition buffers and the seam vertices); the mesh is written as it grows.
+#include <OpenGP/MLogger.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <unordered_map>
+#include <algorithm>
+#include "Grid.h"
+#include "GridSampler.h"
+#include "MarchingCubes.h"
+#include "../ImplicitHoppe.h"
+#include "../ImplicitRBF.h"
+
+using namespace OpenGP;
+
+/// Reads the "v" (or "vn") lines of an OBJ file one at a time
+class ObjReader{
+    std::ifstream in;
+    std::string tag;
+    std::string line;
+public:
+    ObjReader(const std::string& path, const std::string& tag) : in(path), tag(tag + " "){
+        if(!in) mFatal() << "File not found: " << path;
+    }
+    bool next(Vec3& v){
+        while(std::getline(in, line)){
+            if(line.compare(0, tag.size(), tag) != 0) continue;
+            const char* s = line.c_str() + tag.size();
+            char* end;
+            for(int i = 0; i < 3; ++i, s = end)
+                v[i] = std::strtof(s, &end);
+            return true;
+        }
+        return false;
+    }
+};
+
+/// Partitioned cloud: (position, normal) records of each tile, buffered and appended to
+/// one binary file per tile. Files left over by an aborted run are removed up front.
+class TileFiles{
+    std::string prefix;
+    std::vector<std::vector<float>> buffers;
+    size_t buffered = 0;
+    const size_t budget = size_t(1) << 26; ///< floats kept in memory over all tiles
+public:
+    TileFiles(const std::string& prefix, int ntiles) : prefix(prefix), buffers(ntiles){
+        for(int tile = 0; tile < ntiles; ++tile)
+            std::remove(path(tile).c_str());
+    }
+    std::string path(int tile) const { return prefix + std::to_string(tile) + ".bin"; }
+
+    void add(int tile, const Vec3& p, const Vec3& n){
+        std::vector<float>& buffer = buffers[tile];
+        buffer.insert(buffer.end(), {p[0], p[1], p[2], n[0], n[1], n[2]});
+        if((buffered += 6) > budget) flush();
+    }
+    void flush(){
+        for(size_t tile = 0; tile < buffers.size(); ++tile){
+            std::vector<float>& buffer = buffers[tile];
+            if(buffer.empty()) continue;
+            FILE* file = std::fopen(path(tile).c_str(), "ab");
+            if(!file) mFatal() << "Cannot write " << path(tile);
+            size_t written = std::fwrite(buffer.data(), sizeof(float), buffer.size(), file);
+            if(std::fclose(file) != 0 || written != buffer.size())
+                mFatal() << "Short write to" << path(tile) << "(disk full?)";
+            std::vector<float>().swap(buffer);
+        }
+        buffered = 0;
+    }
+    /// Loads (and deletes) the file of a tile; false if the tile is empty
+    bool load(int tile, SurfaceMesh& cloud) const{
+        FILE* file = std::fopen(path(tile).c_str(), "rb");
+        if(!file) return false;
+        auto vnormals = cloud.vertex_property<Vec3>("v:normal");
+        float record[6];
+        while(std::fread(record, sizeof(float), 6, file) == 6){
+            SurfaceMesh::Vertex v = cloud.add_vertex(Vec3(record[0], record[1], record[2]));
+            vnormals[v] = Vec3(record[3], record[4], record[5]);
+        }
+        std::fclose(file);
+        std::remove(path(tile).c_str());
+        return cloud.n_vertices() > 0;
+    }
+};
+
+/// Global grid: res^3 nodes over the (cubified, enlarged) bounding box of the cloud
+struct GlobalGrid{
+    Vec3 origin;
+    Scalar h;
+    int res;
+    int tile;           ///< tile size, in cells
+    int ntiles;         ///< per axis
+
+    Eigen::Vector3d coords(const Vec3& p) const { return ((p - origin) / h).cast<double>(); }
+    int tile_id(int i, int j, int k) const { return (i * ntiles + j) * ntiles + k; }
+
+    /// Identifies a global grid edge by its lower node and axis (key: axis, 3x20 bits of coordinates)
+    static uint64_t edge_key(const Eigen::Vector3i& node, int axis){
+        uint64_t key = axis;
+        for(int d = 0; d < 3; ++d)
+            key = (key << 20) | (uint64_t) node[d];
+        return key;
+    }
+};
+
+enum Method{ HOPPE, RBF, COMPACT, TREECODE };
+
+template <class Implicit>
+void sample(Grid& grid, const Implicit& implicit){ GridSampler::exec(grid, implicit); }
+
+void sample(Grid& grid, SurfaceMesh& cloud, Method method, int k){
+    switch(method){
+    case HOPPE:    sample(grid, ImplicitHoppe(cloud, k)); break;
+    case RBF:      sample(grid, ImplicitRBF(cloud)); break;
+    case COMPACT:  sample(grid, ImplicitRBF(cloud, ImplicitRBF::COMPACT)); break;
+    case TREECODE: sample(grid, ImplicitRBF(cloud, ImplicitRBF::TREECODE)); break;
+    }
+}
+
+int main(int argc, char** argv){
+    if(argc < 3) mFatal() << "usage: stream_reconstruct input.obj output.obj [-r res] [-t tile] [-o overlap] [-m method]";
+    std::string input = argv[1], output = argv[2];
+    int res = 256, tile = 64, overlap = 4, k = 1;
+    Method method = HOPPE;
+    for(int a = 3; a + 1 < argc; a += 2){
+        std::string option = argv[a], value = argv[a + 1];
+        if(option == "-r") res = std::atoi(value.c_str());
+        else if(option == "-t") tile = std::atoi(value.c_str());
+        else if(option == "-o") overlap = std::atoi(value.c_str());
+        else if(option == "-m"){
+            if(value.compare(0, 5, "hoppe") == 0){ method = HOPPE; k = std::max(1, std::atoi(value.c_str() + 5)); }
+            else if(value == "rbf") method = RBF;
+            else if(value == "compact") method = COMPACT;
+            else if(value == "treecode") method = TREECODE;
+            else mFatal() << "Unknown method: " << value;
+        }
+        else mFatal() << "Unknown option: " << option;
+    }
+    if(res < 2 || tile < 1 || res > (1 << 20)) mFatal() << "Invalid resolution/tile size";
+
+    // Pass 1: bounding box, the global grid as in reconstruct()
+    std::cout << "Scanning " << input << "\n" << std::flush;
+    Box3 bbox;
+    bbox.setNull();
+    size_t npoints = 0;
+    {
+        ObjReader points(input, "v");
+        Vec3 p;
+        while(points.next(p)){ bbox.extend(p); ++npoints; }
+    }
+    if(npoints == 0) mFatal() << "No points in " << input;
+    bbox = bbox_scaled(bbox_cubified(bbox), 1.1);
+
+    GlobalGrid grid;
+    grid.origin = bbox.min();
+    grid.res = res;
+    grid.h = (bbox.max().x() - bbox.min().x()) / (res - 1);
+    grid.tile = tile;
+    grid.ntiles = (res - 2) / tile + 1;
+    int ntiles = grid.ntiles * grid.ntiles * grid.ntiles;
+    mDebug() << MLogger::nospace << npoints << " points, " << res << "^3 grid, "
+             << grid.ntiles << "^3 tiles of " << tile << "^3 cells";
+
+    // Pass 2: partition, each point goes to every tile whose box, grown by the overlap, contains it
+    std::cout << "Partitioning\n" << std::flush;
+    TileFiles files(output + ".tile", ntiles);
+    {
+        ObjReader points(input, "v"), normals(input, "vn");
+        Vec3 p, n;
+        while(points.next(p)){
+            if(!normals.next(n)) mFatal() << "The cloud needs one normal (vn) per point";
+            Eigen::Vector3d g = grid.coords(p);
+            int lo[3], hi[3];
+            for(int d = 0; d < 3; ++d){
+                lo[d] = std::max(0, (int) std::floor((g[d] - overlap) / tile));
+                hi[d] = std::min(grid.ntiles - 1, (int) std::floor((g[d] + overlap) / tile));
+            }
+            for(int i = lo[0]; i <= hi[0]; ++i)
+                for(int j = lo[1]; j <= hi[1]; ++j)
+                    for(int l = lo[2]; l <= hi[2]; ++l)
+                        files.add(grid.tile_id(i, j, l), p, n);
+        }
+        files.flush();
+    }
+
+    // Pass 3: reconstruct tile by tile, stitching the vertices on the tile boundaries
+    FILE* out = std::fopen(output.c_str(), "w");
+    if(!out) mFatal() << "Cannot write " << output;
+    std::unordered_map<uint64_t, std::pair<int, Vec3>> seam; ///< global edge -> output vertex (1-based), position
+    int nvertices = 0, nfaces = 0, mismatches = 0;
+    for(int i = 0; i < grid.ntiles; ++i)
+    for(int j = 0; j < grid.ntiles; ++j)
+    for(int l = 0; l < grid.ntiles; ++l){
+        SurfaceMesh cloud;
+        if(!files.load(grid.tile_id(i, j, l), cloud)) continue;
+
+        // this tile's nodes of the global grid
+        Eigen::Vector3i lo(i * tile, j * tile, l * tile);
+        Eigen::Vector3i hi = (lo.array() + tile).min(res - 1);
+        Box3 box(grid.origin + grid.h * lo.cast<Scalar>(), grid.origin + grid.h * hi.cast<Scalar>());
+        Eigen::Vector3i nodes = hi - lo + Eigen::Vector3i::Ones();
+        Grid tile_grid(box, nodes[0], nodes[1], nodes[2]);
+        sample(tile_grid, cloud, method, k);
+
+        SurfaceMesh mesh;
+        std::vector<MarchingCubes::Edge> edges;
+        MarchingCubes::exec(tile_grid, mesh, 0, &edges);
+        mDebug() << MLogger::nospace << "Tile (" << i << "," << j << "," << l << "): "
+                 << cloud.n_vertices() << " points, " << mesh.n_faces() << " triangles";
+
+        // vertices on the boundary planes may have been emitted by a neighbor tile
+        std::vector<int> index(mesh.n_vertices());
+        for(auto v : mesh.vertices()){
+            const Vec3& p = mesh.position(v);
+            const MarchingCubes::Edge& edge = edges[v.idx()];
+            Eigen::Vector3i node = lo + edge.node.cast<int>();
+            bool on_boundary = false;
+            for(int d = 0; d < 3; ++d)
+                on_boundary |= d != edge.axis && (node[d] == lo[d] || node[d] == hi[d]);
+            if(on_boundary){
+                auto inserted = seam.insert(std::make_pair(GlobalGrid::edge_key(node, edge.axis), std::make_pair(nvertices + 1, p)));
+                if(!inserted.second){
+                    index[v.idx()] = inserted.first->second.first;
+                    if((inserted.first->second.second - p).norm() > 1e-3 * grid.h) ++mismatches;
+                    continue;
+                }
+            }
+            std::fprintf(out, "v %f %f %f\n", p[0], p[1], p[2]);
+            index[v.idx()] = ++nvertices;
+        }
+        for(auto f : mesh.faces()){
+            std::fprintf(out, "f");
+            for(auto v : mesh.vertices(f))
+                std::fprintf(out, " %d", index[v.idx()]);
+            std::fprintf(out, "\n");
+            ++nfaces;
+        }
+    }
+    std::fclose(out);
+    if(mismatches > 0)
+        mWarning() << mismatches << "seam vertices differ between tiles, consider a larger overlap (-o)";
+    mDebug() << MLogger::nospace << "Done! [#V:" << nvertices << " #F:" << nfaces << "] written to " << output;
+    return 0;
+}
@@ -1,8 +1,11 @@
 #include "Decimator.h"
 #include <OpenGP/MLogger.h>
+#include <cmath>
+#include <algorithm>
 
 /// is the collapse of halfedge h allowed? (check for manifold, foldovers, etc...)
-bool Decimator::is_collapse_legal(Halfedge h){
+/// (the collapse is simulated on local copies: safe to call concurrently)
+bool Decimator::is_collapse_legal(Halfedge h) const{
     // tests for collapse candidate: v0 ---> v1
     Vertex v0 = mesh.from_vertex(h);
     Vertex v1 = mesh.to_vertex(h);
@@ -19,32 +22,30 @@ bool Decimator::is_collapse_legal(Halfedge h){
         return false;
 
     /// TEST: check for face foldovers
-    bool causes_foldover = false;
-    Point old_p0 = vpoints[v0]; ///< used to undo collapse simulation
-    vpoints[v0] = vpoints[v1]; ///< simulates the collapse
-    {
-
-	for (auto && he : mesh.halfedges(v0)) {
-			SurfaceMesh::Face current_face = mesh.face(he); // grab current face
-			SurfaceMesh::Face next_face = mesh.face(mesh.opposite_halfedge(mesh.next_halfedge(he))); // get next adjacent face
-
-			auto current_normal = mesh.compute_face_normal(current_face);
-			auto next_normal = mesh.compute_face_normal(next_face);
-
-			auto cos_of_dihedral = - current_normal.dot(next_normal) / (current_normal.norm() * next_normal.norm() );
-
-			if (cos_of_dihedral >= min_cos) {
-				causes_foldover = true;
-			}
-
-		}
+    Face fl = mesh.face(h);                         ///< removed by the collapse
+    Face fr = mesh.face(mesh.opposite_halfedge(h));
+    Point target = (placement == OPTIMAL) ? collapse_target(h, vquadrics[v0] + vquadrics[v1]) : vpoints[v1];
+    auto position = [&](Vertex v) -> const Point& { return (v == v0 || v == v1) ? target : vpoints[v]; };
+    auto normal = [&](Face f) -> Normal { ///< as SurfaceMesh::compute_face_normal(), after the collapse
+        Halfedge he = mesh.halfedge(f);
+        Point p0 = position(mesh.to_vertex(he));
+        Point p1 = position(mesh.to_vertex(he = mesh.next_halfedge(he)));
+        Point p2 = position(mesh.to_vertex(mesh.next_halfedge(he)));
+        return ((p2-=p1).cross(p0-=p1)).normalized();
+    };
+    for (Vertex v : {v0, v1}) {
+        if (placement == ENDPOINT && v == v1) break; ///< v1 does not move
         /// TASK: Check that the (post-collapse) faces have cos(dihedral)<min_cos
         /// note: decimation would still run without this!
-        /// hint: see SurfaceMesh::compute_face_normal()
+        for (auto && he : mesh.halfedges(v)) {
+            Face current_face = mesh.face(he);
+            Face next_face = mesh.face(mesh.opposite_halfedge(mesh.next_halfedge(he))); ///< across the far edge
+            if (current_face == fl || current_face == fr || next_face == fl || next_face == fr)
+                continue; ///< degenerate once collapsed
+            if (-normal(current_face).dot(normal(next_face)) >= min_cos)
+                return false;
+        }
     }
-    vpoints[v0] = old_p0; ///< undo simulation
-    if(causes_foldover) 
-        return false;
 
     return true; ///< all tests passed!
 }
@@ -56,33 +57,92 @@ Scalar Decimator::halfedge_collapse_cost(Halfedge h){
     /// hint: Get/set the quadric of a vertex v by calling quadrics[v]
     auto v_i = mesh.from_vertex(h);
     auto v_j = mesh.to_vertex(h);
-    auto Q_i = vquadrics[v_i];
-    auto Q_j = vquadrics[v_j];
-    auto Q_new = Q_i + Q_j;
-    auto cost = Q_new.evaluate(vpoints[v_j]);
+    const Quadric& Q_i = vquadrics[v_i];
+    const Quadric& Q_j = vquadrics[v_j];
+    Quadric Q_new = Q_i + Q_j;
+    auto cost = Q_new.evaluate(collapse_target(h, Q_new));
 
     return cost;
 }
 
+/// halfedge_collapse_cost(h), only re-evaluated when an endpoint changed
+/// (writes the cache of h only: safe to call concurrently for distinct halfedges)
+Scalar Decimator::cached_collapse_cost(Halfedge h){
+    if (std::isnan(hcost[h]))
+        hcost[h] = halfedge_collapse_cost(h);
+    return hcost[h];
+}
+
+/// the quadric (or position) of v changed: so did the cost of its in/out-going halfedges
+void Decimator::invalidate_costs(Vertex v){
+    for (auto && h : mesh.halfedges(v)) {
+        hcost[h] = NAN;
+        hcost[mesh.opposite_halfedge(h)] = NAN;
+    }
+}
+
+/// where does v1 end up when collapsing h (Q: the summed quadric of its endpoints)?
+Point Decimator::collapse_target(Halfedge h, const Quadric& Q) const{
+    Point p0 = vpoints[mesh.from_vertex(h)];
+    Point p1 = vpoints[mesh.to_vertex(h)];
+    if (placement == ENDPOINT) return p1;
+
+    Point midpoint = (p0 + p1) / 2;
+    Point x;
+    if (Q.minimizer(x) && (x - midpoint).norm() <= (p1 - p0).norm())
+        return x;
+
+    // singular (e.g. flat) or far off: best of the endpoints and the midpoint
+    Point best = p1;
+    for (const Point& p : {p0, midpoint})
+        if (Q.evaluate(p) < Q.evaluate(best)) best = p;
+    return best;
+}
+
+/// smallest error out-going halfedge collapse of v (invalid if none)
+Decimator::Halfedge Decimator::best_halfedge(Vertex v, Scalar& best_cost){
+    Halfedge best; ///< invalid!
+    best_cost = inf();
+    for (auto && h : mesh.halfedges(v)) {
+        Scalar cost = cached_collapse_cost(h);
+        if (cost < best_cost) {
+            best_cost = cost;
+            best = h;
+        }
+    }
+    return best;
+}
+
 /// Find smallest half-edge collapse for vertex and (potentially) add it to the queue
 void Decimator::enqueue_vertex(Vertex v){
-    Halfedge best_halfedge; ///< invalid!
-    Scalar best_halfedge_cost = inf();
-    
     /// TASK
     /// 1) find smallest error out-going halfedge collapse
     /// 2) add the best halfedge to the priority queue
+    Scalar best_halfedge_cost;
+    Halfedge best = best_halfedge(v, best_halfedge_cost);
     
-    for (auto && h : mesh.halfedges(v)) {
-        if (halfedge_collapse_cost(h) < best_halfedge_cost) {
-            best_halfedge_cost = halfedge_collapse_cost(h);
-            best_halfedge = h;
-        }
-    }
-    
-    if (is_collapse_legal(best_halfedge)) queue.insert_or_update(best_halfedge, best_halfedge_cost);
+    /// (an infeasible best candidate also drops the previous, now stale, one)
+    if (is_collapse_legal(best)) queue.insert_or_update(best, best_halfedge_cost);
+    else queue.remove(v);
 }
 
+/// collapse v0 ---> v1, moving v1 to "target", and update the data around v1
+void Decimator::collapse(Halfedge h, const Point& target){
+    Vertex v0 = mesh.from_vertex(h);
+    Vertex v1 = mesh.to_vertex(h);
+    Quadric Q = vquadrics[v0] + vquadrics[v1];
+    if (progressive) progressive->record(mesh, h, target);
+    mesh.collapse(h);
+    vpoints[v1] = target;
+    /// the quadric of v1 inherits the planes of v0
+    vquadrics[v1] = Q;
+    invalidate_costs(v1); ///< (the halfedges of v0 now leave v1)
+    if (update_face_normals)
+        for (auto&& face : mesh.faces(v1))
+            fnormals[face] = mesh.compute_face_normal(face);
+}
+
+/// quadric of the planes of the faces around the vertex (initialization)
 void Decimator::update_quadric(Vertex vertex) {
     
     vquadrics[vertex].clear();
@@ -103,11 +163,15 @@ void Decimator::init(){
     /// TASK: traverse all vertices and initialize the priority queue
     /// hint: Decimator::enqueue_vertex is to be used here
     
-    for (auto&& vertex : mesh.vertices()) {
-
+    /// (all quadrics first: the costs of a vertex depend on those of its neighbors)
+    queue.clear();
+    n_illegal = 0;
+    for (auto&& vertex : mesh.vertices())
         update_quadric(vertex);
+    for (auto&& h : mesh.halfedges())
+        hcost[h] = NAN;
+    for (auto&& vertex : mesh.vertices())
         Decimator::enqueue_vertex(vertex);
-    }
 
 }
 
@@ -122,11 +186,10 @@ void Decimator::exec(unsigned int target_n_vertices){
 
         /// TASK: main execution logic
         /// 1) check if this collapse is legal
-        if (!is_collapse_legal(h)) continue;
+        if (!is_collapse_legal(h)) { ++n_illegal; continue; }
         /// 2) perform the halfedge collapse (see docs)
-        mesh.collapse(h);
         /// 3) update the quadric of v1
-        Decimator::update_quadric(v1);
+        collapse(h, collapse_target(h, vquadrics[v0] + vquadrics[v1]));
         /// 4) re-compute the collapse costs in neighborhood of v1
         for (auto && out_edge : mesh.halfedges(v1)) {
             enqueue_vertex(mesh.to_vertex(out_edge));
@@ -139,3 +202,92 @@ void Decimator::exec(unsigned int target_n_vertices){
             mLogger() << "#v:" << mesh.n_vertices();
     }
 }
+
+void Decimator::exec_parallel(unsigned int target_n_vertices){
+    mLogger() << "Decimator::exec_parallel" << mesh.n_vertices() << target_n_vertices << "in progress...";
+
+    struct Candidate{
+        Halfedge h;
+        Point target;
+        bool legal;
+    };
+    std::vector<Candidate> selected;
+    std::vector<Vertex> affected, stale;
+    std::vector<std::pair<Halfedge, Scalar>> best;
+    auto vround = mesh.add_vertex_property<int>("v:round", -1); ///< last round a vertex was claimed in
+
+    for (int round = 0; mesh.n_vertices() > target_n_vertices && !queue.is_empty(); ++round) {
+        // 1) greedy independent set among the best candidates: a collapse claims the
+        //    closed one-rings of both its vertices. The queue is visited in place, the
+        //    overlapping candidates stay queued for the next round and only the
+        //    selected ones are popped.
+        size_t n_wanted = std::min<size_t>(mesh.n_vertices() - target_n_vertices,
+                                           std::max<size_t>(1, mesh.n_vertices() / 16));
+        selected.clear();
+        affected.clear();
+        stale.clear();
+        size_t visited = 0;
+        queue.visit([&](Vertex v, Halfedge h){
+            if (mesh.is_deleted(h)) {
+                stale.push_back(v);
+                return true;
+            }
+            Vertex v0 = mesh.from_vertex(h);
+            Vertex v1 = mesh.to_vertex(h);
+            bool is_free = true;
+            for (Vertex u : {v0, v1}) {
+                is_free &= (vround[u] != round);
+                for (auto && out_edge : mesh.halfedges(u))
+                    is_free &= (vround[mesh.to_vertex(out_edge)] != round);
+            }
+            if (is_free) {
+                for (Vertex u : {v0, v1}) {
+                    vround[u] = round;
+                    for (auto && out_edge : mesh.halfedges(u))
+                        vround[mesh.to_vertex(out_edge)] = round;
+                }
+                selected.push_back({h, Point(), false});
+            }
+            return ++visited < 2 * n_wanted && selected.size() < n_wanted;
+        });
+        for (Vertex v : stale)
+            queue.remove(v);
+        for (const Candidate& c : selected)
+            queue.pop(mesh.from_vertex(c.h));
+
+        // 2) legality and placement (both read-only)
+        #pragma omp parallel for schedule(dynamic, 16)
+        for (int i = 0; i < (int) selected.size(); ++i) {
+            Candidate& c = selected[i];
+            c.legal = is_collapse_legal(c.h);
+            if (c.legal)
+                c.target = collapse_target(c.h, vquadrics[mesh.from_vertex(c.h)] + vquadrics[mesh.to_vertex(c.h)]);
+        }
+
+        // 3) collapses; an illegal candidate is dropped until its neighborhood changes (as in exec)
+        for (const Candidate& c : selected) {
+            if (!c.legal) { ++n_illegal; continue; }
+            Vertex v1 = mesh.to_vertex(c.h);
+            collapse(c.h, c.target);
+            affected.push_back(v1);
+            for (auto && out_edge : mesh.halfedges(v1))
+                affected.push_back(mesh.to_vertex(out_edge));
+        }
+
+        // 4) re-compute the best collapses of the affected vertices (each only writes the
+        //    cached costs of its own out-going halfedges); legality is checked once popped
+        std::sort(affected.begin(), affected.end());
+        affected.erase(std::unique(affected.begin(), affected.end()), affected.end());
+        best.resize(affected.size());
+        #pragma omp parallel for schedule(dynamic, 64)
+        for (int i = 0; i < (int) affected.size(); ++i)
+            best[i].first = best_halfedge(affected[i], best[i].second);
+        for (size_t i = 0; i < affected.size(); ++i) {
+            if (best[i].first.is_valid()) queue.insert_or_update(best[i].first, best[i].second);
+            else queue.remove(affected[i]);
+        }
+
+        mLogger() << "#v:" << mesh.n_vertices();
+    }
+    mesh.remove_vertex_property(vround);
+}
@@ -2,9 +2,16 @@
 #include <OpenGP/SurfaceMesh/Surfacemesh.h>
 #include "Quadric.h"
 #include "PriorityQueue.h"
+#include "ProgressiveMesh.h"
 
 /// @brief Halfedge mesh decimation with quadric error metrics
 class Decimator{
+public:
+    /// ENDPOINT collapses v0 onto v1, OPTIMAL also moves v1 to the position that
+    /// minimizes the summed quadric (falling back to the best of v0, v1 and their
+    /// midpoint when the quadric is singular or its minimizer is far off the edge)
+    enum Placement{ ENDPOINT, OPTIMAL };
+private:
     typedef SurfaceMesh::Halfedge Halfedge;
     typedef SurfaceMesh::Vertex   Vertex;
     typedef SurfaceMesh::Face     Face;
@@ -15,18 +22,23 @@ private:
     SurfaceMesh::Vertex_property<Vec3> vpoints;     
     SurfaceMesh::Vertex_property<Quadric> vquadrics;
     SurfaceMesh::Face_property<Vec3> fnormals;
+    SurfaceMesh::Halfedge_property<Scalar> hcost;  ///< cached halfedge_collapse_cost(), NaN once an endpoint changed
     PriorityQueue queue; /// sort the halfedge collapses
+    size_t n_illegal = 0; ///< popped collapses rejected by is_collapse_legal (since init)
+    Placement placement;
     const float min_cos = std::cos(0.25*M_PI); ///< min angle (avoid face foldover)
 /// @} 
 
 /// @{ constructors
 public:
-    Decimator(SurfaceMesh& mesh) : mesh(mesh), queue(mesh){
+    Decimator(SurfaceMesh& mesh, Placement placement = ENDPOINT) : mesh(mesh), queue(mesh), placement(placement){
         vpoints = mesh.vertex_property<Point>("v:point");
         fnormals = mesh.face_property<Normal>("f:normal");
         vquadrics = mesh.add_vertex_property<Quadric>("v:quadric");
+        hcost = mesh.add_halfedge_property<Scalar>("h:cost", NAN);
     }        
     ~Decimator(){
+        mesh.remove_halfedge_property(hcost);
         mesh.remove_vertex_property(vquadrics);        
         // now, delete the items that have been marked to be deleted
         // (SurfaceMesh::collapse marks several elements as such)
@@ -36,12 +48,38 @@ public:
 
 /// @{ algorithm implementation
 public:
+    /// Recompute "f:normal" of the faces changed by each collapse (the one-ring of
+    /// the kept vertex), so that normals stay valid without a full update afterwards
+    bool update_face_normals = false;
+    /// If set, every collapse is recorded (the progressive mesh must have been
+    /// created from the mesh in its state when the recording started)
+    ProgressiveMesh* progressive = nullptr;
+
     void init();
     void exec(unsigned int target_n_vertices);
+    /// As exec(), in rounds: the best candidates with pairwise disjoint (closed) one-rings
+    /// are selected greedily (visiting the queue in place, the others stay queued), their
+    /// legality and placement evaluated in parallel, then collapsed and the candidates
+    /// around them re-evaluated in parallel. The collapses themselves stay serial, as
+    /// SurfaceMesh updates are not thread-safe; they are most of the work, so the speedup
+    /// over exec() is bounded well below the number of threads. Slightly lower quality
+    /// than exec(), as a round does not see the cost changes caused by its own collapses.
+    void exec_parallel(unsigned int target_n_vertices);
+    /// Sum of the squared distances from v to the planes of the input faces merged into it
+    Scalar quadric_error(Vertex v) const { return vquadrics[v].evaluate(vpoints[v]); }
+    /// Priority queue operation counts (since init)
+    const PriorityQueue::Stats& queue_stats() const { return queue.stats; }
+    /// Popped collapses rejected as illegal (since init)
+    size_t n_illegal_collapses() const { return n_illegal; }
 private:
-    bool  is_collapse_legal(Halfedge h);
+    bool  is_collapse_legal(Halfedge h) const;
     Scalar halfedge_collapse_cost(Halfedge h);
+    Scalar cached_collapse_cost(Halfedge h);
+    void  invalidate_costs(Vertex v);
+    Point collapse_target(Halfedge h, const Quadric& Q) const;
+    Halfedge best_halfedge(Vertex v, Scalar& cost);
     void  enqueue_vertex(Vertex v);
+    void  collapse(Halfedge h, const Point& target);
     void update_quadric(Vertex v);
 /// @}
 };
@@ -1,47 +1,112 @@
 #include "PriorityQueue.h"
+#include <algorithm>
 
-PriorityQueue::PriorityQueue(SurfaceMesh &mesh) : mesh(mesh), _queue(vcost){
+PriorityQueue::PriorityQueue(SurfaceMesh &mesh) : mesh(mesh){
     vcost = mesh.add_vertex_property<Scalar>("v:cost");
     vtarget = mesh.add_vertex_property<Halfedge>("v:target");
+    vheap = mesh.add_vertex_property<int>("v:heap", -1);
+    _heap.reserve(mesh.n_vertices());
 }
 
 PriorityQueue::~PriorityQueue(){
+    mesh.remove_vertex_property(vheap);
     mesh.remove_vertex_property(vtarget);
     mesh.remove_vertex_property(vcost);
 }
 
 void PriorityQueue::insert_or_update(PriorityQueue::Halfedge h, Scalar h_cost){
-    if(!h.is_valid()) return;
-    Vertex v = mesh.from_vertex(h);
-    
-    // if (!=-1) then it's already in queue, so needs updating
-    // but std::set doesn't support update, thus we remove+insert
-    if(vcost[v] != -1.0){
-        _queue.erase(v);
-        vcost[v] = -1.0;
-    }
-    
     // Couldn't find a feasible candidate?
     // ... then the vertex is left alone
     if(!h.is_valid()) return;
-    
-    // Good candidate exists, let's insert it in queue        
+    Vertex v = mesh.from_vertex(h);
     vtarget[v] = h;
+
+    // not queued yet: append, then restore the heap order upwards
+    if(vheap[v] < 0){
+        ++stats.inserts;
+        vcost[v] = h_cost;
+        _heap.push_back(v);
+        vheap[v] = (int) _heap.size() - 1;
+        sift_up(vheap[v]);
+        return;
+    }
+
+    // already in queue: the new cost moves it either up or down
+    ++stats.updates;
+    Scalar old_cost = vcost[v];
     vcost[v] = h_cost;
-    _queue.insert(v);
+    if(h_cost < old_cost) sift_up(vheap[v]);
+    else sift_down(vheap[v]);
 }
 
 PriorityQueue::Halfedge PriorityQueue::pop(){
-    Vertex v = *_queue.begin(); //< get 1st element
-    _queue.erase(_queue.begin());  //< then erase it
+    ++stats.pops;
+    Vertex v = _heap.front(); //< get 1st element
+    Vertex last = _heap.back();
+    _heap.pop_back();
+    vheap[v] = -1;
+    if(!_heap.empty()){  //< then fill its slot with the last one
+        place(last, 0);
+        sift_down(0);
+    }
+    return vtarget[v];
+}
+
+PriorityQueue::Halfedge PriorityQueue::pop(Vertex v){
+    ++stats.pops;
+    erase(vheap[v]);
     return vtarget[v];
 }
 
+void PriorityQueue::remove(Vertex v){
+    int slot = vheap[v];
+    if(slot < 0) return;
+    ++stats.removes;
+    erase(slot);
+}
+
+void PriorityQueue::erase(int slot){
+    vheap[_heap[slot]] = -1;
+    Vertex last = _heap.back();
+    _heap.pop_back();
+    if(slot == (int) _heap.size()) return;
+    // the last entry takes the freed slot, then moves whichever way restores the order
+    place(last, slot);
+    sift_up(slot);
+    sift_down(vheap[last]);
+}
+
 void PriorityQueue::clear(){ 
-    // initialize vertex costs
-    for(auto v: mesh.vertices())
-        vcost[v] = -1.0;
-    
-    // initialize priority queue
-    _queue.clear(); 
+    for(Vertex v: _heap)
+        vheap[v] = -1;
+    _heap.clear(); 
+    stats = Stats();
+}
+
+void PriorityQueue::sift_up(int slot){
+    Vertex v = _heap[slot];
+    while(slot > 0){
+        int parent = (slot - 1) / ARITY;
+        if(!less(v, _heap[parent])) break;
+        place(_heap[parent], slot);
+        slot = parent;
+    }
+    place(v, slot);
+}
+
+void PriorityQueue::sift_down(int slot){
+    Vertex v = _heap[slot];
+    int n = (int) _heap.size();
+    for(;;){
+        int first = ARITY * slot + 1;
+        if(first >= n) break;
+        // best of the (up to) ARITY children
+        int best = first;
+        for(int child = first + 1; child < std::min(first + ARITY, n); ++child)
+            if(less(_heap[child], _heap[best])) best = child;
+        if(!less(_heap[best], v)) break;
+        place(_heap[best], slot);
+        slot = best;
+    }
+    place(v, slot);
 }
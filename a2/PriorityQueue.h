@@ -1,37 +1,32 @@
 #pragma once
-#include <set>
+#include <vector>
+#include <algorithm>
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
 
 using namespace OpenGP;
 
-/// @brief compare functor for priority queue
-class VertexCompare{
-    typedef SurfaceMesh::Vertex Vertex;
-    typedef SurfaceMesh::Vertex_property<float> PerVertexFloat;
-private:
-    const PerVertexFloat& vprio_;
-public:
-    VertexCompare(const PerVertexFloat& _vprio) : vprio_(_vprio) {}
-    
-    /// is error introduced by removing v0 less than that of v1?
-    bool operator()(Vertex v0, Vertex v1) const{
-        float p0 = vprio_[v0];
-        float p1 = vprio_[v1];
-        // note: std::set needs UNIQUE keys -> handle equal priorities
-        return ( (p0 == p1) ? (v0.idx() < v1.idx()) : (p0 < p1) );
-    }
-};
-
 /// priority queue to fetch the next vertex removal operation (halfedge collapse)
+/// Indexed 4-ary min-heap of vertices: the heap is a contiguous array, every vertex
+/// knows its slot ("v:heap"), so updating a cost is a sift up/down in O(log n)
+/// without any allocation. Equal costs are ordered by vertex index.
 class PriorityQueue {
     typedef SurfaceMesh::Vertex Vertex;
     typedef SurfaceMesh::Halfedge Halfedge;
-    typedef std::set<SurfaceMesh::Vertex, VertexCompare> VertexQueue;
+    static const int ARITY = 4;
 private:
     SurfaceMesh& mesh;
-    VertexQueue _queue;
+    std::vector<Vertex> _heap;
     SurfaceMesh::Vertex_property<Scalar> vcost;
     SurfaceMesh::Vertex_property<Halfedge> vtarget;
+    SurfaceMesh::Vertex_property<int> vheap; ///< slot in _heap, -1 if not queued
+
+public:
+    /// operation counts since construction (or the last clear()), e.g. for benchmarks
+    struct Stats{
+        size_t inserts = 0, updates = 0, pops = 0, removes = 0;
+        size_t peeks = 0; ///< candidates visited in place (see visit)
+    };
+    Stats stats;
 
 public:
     PriorityQueue(SurfaceMesh& mesh);
@@ -39,7 +34,7 @@ public:
 
 public:
     /// If the queue is empty, then we have nothign else to decimate
-    bool is_empty(){ return _queue.empty(); }
+    bool is_empty(){ return _heap.empty(); }
     
     /// Insert the halfedge h to the collapse candidates queue
     /// If the "from" vertex already has a candidate, then update it.
@@ -47,7 +42,52 @@ public:
     
     /// Pop the best collapse candidate from the queue
     Halfedge pop();
+    /// Pop the candidate of v, e.g. one picked by visit()
+    Halfedge pop(Vertex v);
+
+    /// Visit the queued candidates best first, without removing them, until
+    /// visitor(v, h) returns false; O(log n) per visited candidate. The queue must
+    /// not be modified while visiting.
+    template <class Visitor>
+    void visit(Visitor visitor);
+
+    /// Drop the candidate of v (if any), e.g. once it is no longer feasible
+    void remove(Vertex v);
     
     /// Reset everything (useful for iterative executions)
     void clear();
+
+private:
+    /// is the candidate of v0 better than that of v1?
+    bool less(Vertex v0, Vertex v1) const{
+        Scalar p0 = vcost[v0];
+        Scalar p1 = vcost[v1];
+        return ( (p0 == p1) ? (v0.idx() < v1.idx()) : (p0 < p1) );
+    }
+    void place(Vertex v, int slot){ _heap[slot] = v; vheap[v] = slot; }
+    void sift_up(int slot);
+    void sift_down(int slot);
+    void erase(int slot);
 };
+
+template <class Visitor>
+void PriorityQueue::visit(Visitor visitor){
+    // frontier of heap slots, itself a (binary) heap: the best of the unvisited
+    // candidates is always a child of a visited one
+    auto worse = [this](int a, int b){ return less(_heap[b], _heap[a]); };
+    std::vector<int> frontier;
+    if(!_heap.empty()) frontier.push_back(0);
+    while(!frontier.empty()){
+        std::pop_heap(frontier.begin(), frontier.end(), worse);
+        int slot = frontier.back();
+        frontier.pop_back();
+        ++stats.peeks;
+        Vertex v = _heap[slot];
+        if(!visitor(v, vtarget[v])) return;
+        int first = ARITY * slot + 1;
+        for(int child = first; child < std::min(first + ARITY, (int) _heap.size()); ++child){
+            frontier.push_back(child);
+            std::push_heap(frontier.begin(), frontier.end(), worse);
+        }
+    }
+}
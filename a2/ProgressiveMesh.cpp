@@ -0,0 +1,255 @@
+#include "ProgressiveMesh.h"
+#include <cassert>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+ProgressiveMesh::ProgressiveMesh(const SurfaceMesh& mesh){
+    auto vpoints = mesh.get_vertex_property<Vec3>("v:point");
+    points_.resize(mesh.vertices_size());
+    vactive_.assign(mesh.vertices_size(), 0);
+    for (auto v : mesh.vertices()) {
+        points_[v.idx()] = vpoints[v];
+        vactive_[v.idx()] = 1;
+        ++n_vertices_;
+    }
+    faces_.resize(mesh.faces_size(), Eigen::Vector3i(-1, -1, -1));
+    factive_.assign(mesh.faces_size(), 0);
+    for (auto f : mesh.faces()) {
+        int i = 0;
+        for (auto v : mesh.vertices(f))
+            if (i < 3) faces_[f.idx()][i++] = v.idx();
+        factive_[f.idx()] = 1;
+        ++n_faces_;
+    }
+}
+
+void ProgressiveMesh::record(const SurfaceMesh& mesh, Halfedge h, const Vec3& target){
+    assert(level_ == collapses_.size());
+    Collapse c;
+    Vertex v0 = mesh.from_vertex(h);
+    c.v0 = v0.idx();
+    c.v1 = mesh.to_vertex(h).idx();
+    Face fl = mesh.face(h);
+    Face fr = mesh.face(mesh.opposite_halfedge(h));
+    c.faces[0] = fl.idx(); ///< -1 if invalid
+    c.faces[1] = fr.idx();
+    c.wedge_begin = (int) wedges_.size();
+    for (auto f : mesh.faces(v0))
+        if (f != fl && f != fr) wedges_.push_back(f.idx());
+    c.wedge_end = (int) wedges_.size();
+    c.p1_before = points_[c.v1];
+    c.p1_after = target;
+    collapses_.push_back(c);
+    apply(c);
+    ++level_;
+}
+
+void ProgressiveMesh::apply(const Collapse& c){
+    for (int f : c.faces)
+        if (f >= 0) { factive_[f] = 0; --n_faces_; }
+    for (int i = c.wedge_begin; i < c.wedge_end; ++i) {
+        Eigen::Vector3i& corners = faces_[wedges_[i]];
+        for (int k = 0; k < 3; ++k)
+            if (corners[k] == c.v0) corners[k] = c.v1;
+    }
+    vactive_[c.v0] = 0;
+    --n_vertices_;
+    points_[c.v1] = c.p1_after;
+}
+
+void ProgressiveMesh::undo(const Collapse& c){
+    points_[c.v1] = c.p1_before;
+    vactive_[c.v0] = 1;
+    ++n_vertices_;
+    for (int i = c.wedge_begin; i < c.wedge_end; ++i) {
+        Eigen::Vector3i& corners = faces_[wedges_[i]];
+        for (int k = 0; k < 3; ++k)
+            if (corners[k] == c.v1) corners[k] = c.v0;
+    }
+    for (int f : c.faces)
+        if (f >= 0) { factive_[f] = 1; ++n_faces_; }
+}
+
+void ProgressiveMesh::set_level(size_t level){
+    level = std::min(level, collapses_.size());
+    while (level_ < level) apply(collapses_[level_++]);
+    while (level_ > level) undo(collapses_[--level_]);
+}
+
+void ProgressiveMesh::set_n_vertices(int n){
+    // each collapse removes exactly one vertex
+    int n_finest = n_vertices_ + (int) level_;
+    set_level((size_t) std::max(0, n_finest - n));
+}
+
+void ProgressiveMesh::extract(SurfaceMesh& mesh) const{
+    mesh.clear();
+    mesh.reserve(n_vertices_, 3 * n_faces_ / 2, n_faces_);
+    std::vector<Vertex> index(points_.size());
+    for (size_t i = 0; i < points_.size(); ++i)
+        if (vactive_[i]) index[i] = mesh.add_vertex(points_[i]);
+    for (size_t f = 0; f < faces_.size(); ++f)
+        if (factive_[f])
+            mesh.add_triangle(index[faces_[f][0]], index[faces_[f][1]], index[faces_[f][2]]);
+}
+
+//=============================================================================
+// Binary layout (host byte order): magic, each array as (size, raw elements), the level
+//=============================================================================
+
+static const char PM_MAGIC[8] = {'O','G','P','P','M','0','0','1'};
+
+template <class T>
+static void write_array(std::ofstream& out, const std::vector<T>& array){
+    uint64_t size = array.size();
+    out.write((const char*) &size, sizeof(size));
+    out.write((const char*) array.data(), size * sizeof(T));
+}
+
+/// Reads a (size, elements) array, failing on sizes larger than what is left of the file
+template <class T>
+static bool read_array(std::ifstream& in, uint64_t file_size, std::vector<T>& array){
+    uint64_t size = 0;
+    if (!in.read((char*) &size, sizeof(size))) return false;
+    if (size > (file_size - (uint64_t) in.tellg()) / sizeof(T)) return false;
+    array.resize(size);
+    return (bool) in.read((char*) array.data(), size * sizeof(T));
+}
+
+bool ProgressiveMesh::write(const std::string& path) const{
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+    out.write(PM_MAGIC, sizeof(PM_MAGIC));
+    write_array(out, points_);
+    write_array(out, faces_);
+    write_array(out, vactive_);
+    write_array(out, factive_);
+    write_array(out, collapses_);
+    write_array(out, wedges_);
+    uint64_t header[3] = {level_, (uint64_t) n_vertices_, (uint64_t) n_faces_};
+    out.write((const char*) header, sizeof(header));
+    return (bool) out;
+}
+
+bool ProgressiveMesh::read(const std::string& path){
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    uint64_t file_size = (uint64_t) in.tellg();
+    in.seekg(0);
+    char magic[sizeof(PM_MAGIC)];
+    if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, PM_MAGIC, sizeof(magic)) != 0)
+        return false;
+
+    // read into a temporary, so that a failed read leaves this one untouched
+    ProgressiveMesh pm;
+    uint64_t header[3];
+    if (!read_array(in, file_size, pm.points_) || !read_array(in, file_size, pm.faces_) ||
+        !read_array(in, file_size, pm.vactive_) || !read_array(in, file_size, pm.factive_) ||
+        !read_array(in, file_size, pm.collapses_) || !read_array(in, file_size, pm.wedges_) ||
+        !in.read((char*) header, sizeof(header)))
+        return false;
+    if (header[0] > pm.collapses_.size() || header[1] > pm.points_.size() || header[2] > pm.faces_.size())
+        return false;
+    pm.level_ = header[0];
+    pm.n_vertices_ = (int) header[1];
+    pm.n_faces_ = (int) header[2];
+    if (!pm.is_valid())
+        return false;
+    std::swap(*this, pm);
+    return true;
+}
+
+bool ProgressiveMesh::is_valid() const{
+    const int n_points = (int) points_.size(), n_faces = (int) faces_.size();
+    if (points_.size() > (size_t) std::numeric_limits<int>::max() || faces_.size() > (size_t) std::numeric_limits<int>::max())
+        return false;
+    if (vactive_.size() != points_.size() || factive_.size() != faces_.size())
+        return false;
+    auto is_vertex = [&](int v){ return v >= 0 && v < n_points; };
+    auto is_face = [&](int f){ return f >= 0 && f < n_faces; };
+    auto is_triangle = [&](int f){ return is_face(f) && is_vertex(faces_[f][0]) && is_vertex(faces_[f][1]) && is_vertex(faces_[f][2]); };
+
+    // faces absent from the recorded mesh have no corners (-1), the others only vertices
+    for (int f = 0; f < n_faces; ++f)
+        for (int k = 0; k < 3; ++k)
+            if (faces_[f][k] != -1 && !is_vertex(faces_[f][k])) return false;
+    std::vector<size_t> seen(n_faces, collapses_.size()); ///< last collapse listing each face
+    for (size_t i = 0; i < collapses_.size(); ++i) {
+        const Collapse& c = collapses_[i];
+        if (!is_vertex(c.v0) || !is_vertex(c.v1) || c.v0 == c.v1)
+            return false;
+        if (c.wedge_begin < 0 || c.wedge_begin > c.wedge_end || c.wedge_end > (int) wedges_.size())
+            return false;
+        // removed faces and wedges: distinct triangles
+        for (int f : c.faces) {
+            if (f == -1) continue;
+            if (!is_triangle(f) || seen[f] == i) return false;
+            seen[f] = i;
+        }
+        for (int w = c.wedge_begin; w < c.wedge_end; ++w) {
+            if (!is_triangle(wedges_[w]) || seen[wedges_[w]] == i) return false;
+            seen[wedges_[w]] = i;
+        }
+    }
+    for (int f = 0; f < n_faces; ++f)
+        if (factive_[f] && !is_triangle(f)) return false;
+    if (n_vertices_ != (int) std::count(vactive_.begin(), vactive_.end(), 1) ||
+        n_faces_ != (int) std::count(factive_.begin(), factive_.end(), 1))
+        return false;
+
+    // Replay all the levels on a copy, down to the finest and up to the coarsest: every
+    // collapse must find its vertices and faces in place, and no active face may be left
+    // on an inactive vertex (valence: number of active faces on each vertex)
+    ProgressiveMesh pm(*this);
+    std::vector<int> valence(n_points, 0);
+    auto has = [&](int f, int v){ return (pm.faces_[f].array() == v).count() == 1; };
+    auto removes = [&](const Collapse& c){
+        for (int f : c.faces)
+            if (f != -1 && (!has(f, c.v0) || !has(f, c.v1))) return false;
+        return true;
+    };
+    for (int f = 0; f < n_faces; ++f)
+        if (factive_[f])
+            for (int k = 0; k < 3; ++k) {
+                if (!vactive_[faces_[f][k]]) return false;
+                ++valence[faces_[f][k]];
+            }
+    while (pm.level_ > 0) {
+        const Collapse& c = collapses_[--pm.level_];
+        if (pm.vactive_[c.v0] || !pm.vactive_[c.v1] || valence[c.v0] != 0)
+            return false;
+        for (int i = c.wedge_begin; i < c.wedge_end; ++i)
+            if (!pm.factive_[wedges_[i]] || !has(wedges_[i], c.v1) || has(wedges_[i], c.v0)) return false;
+        if (!removes(c)) return false;
+        for (int f : c.faces)
+            if (f != -1 && pm.factive_[f]) return false;
+        pm.undo(c);
+        valence[c.v1] -= c.wedge_end - c.wedge_begin;
+        valence[c.v0] += c.wedge_end - c.wedge_begin;
+        for (int f : c.faces)
+            if (f != -1)
+                for (int k = 0; k < 3; ++k) {
+                    if (!pm.vactive_[pm.faces_[f][k]]) return false;
+                    ++valence[pm.faces_[f][k]];
+                }
+    }
+    while (pm.level_ < collapses_.size()) {
+        const Collapse& c = collapses_[pm.level_++];
+        if (!pm.vactive_[c.v0] || !pm.vactive_[c.v1] || !removes(c))
+            return false;
+        for (int f : c.faces)
+            if (f != -1) {
+                if (!pm.factive_[f]) return false;
+                for (int k = 0; k < 3; ++k) --valence[pm.faces_[f][k]];
+            }
+        for (int i = c.wedge_begin; i < c.wedge_end; ++i)
+            if (!pm.factive_[wedges_[i]] || !has(wedges_[i], c.v0) || has(wedges_[i], c.v1)) return false;
+        pm.apply(c);
+        valence[c.v0] -= c.wedge_end - c.wedge_begin;
+        valence[c.v1] += c.wedge_end - c.wedge_begin;
+        if (valence[c.v0] != 0) return false;
+    }
+    return true;
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+
+using namespace OpenGP;
+
+/// @brief Progressive mesh: a full resolution mesh plus the sequence of halfedge
+/// collapses that decimated it (as recorded by the Decimator). Any level of detail
+/// is reached by applying (coarsen) or undoing (refine, i.e. vertex split) the
+/// collapses from the current one, in O(number of collapses in between).
+/// Vertices and faces keep the indices of the mesh the recording started from.
+class ProgressiveMesh{
+    typedef SurfaceMesh::Halfedge Halfedge;
+    typedef SurfaceMesh::Vertex   Vertex;
+    typedef SurfaceMesh::Face     Face;
+public:
+    /// collapse v0 ---> v1 (its inverse is the vertex split v1 ---> v0, v1)
+    struct Collapse{
+        int v0, v1;
+        int faces[2];              ///< removed faces, left and right of v0->v1 (-1 on a boundary)
+        int wedge_begin, wedge_end; ///< range in wedges_: the other faces of v0, which move to v1
+        Vec3 p1_before, p1_after;  ///< v1 is moved by optimal placement
+    };
+
+private:
+    std::vector<Vec3> points_;
+    std::vector<Eigen::Vector3i> faces_;   ///< corners (current level)
+    std::vector<char> vactive_, factive_;
+    std::vector<Collapse> collapses_;
+    std::vector<int> wedges_;
+    size_t level_ = 0;                     ///< number of collapses applied
+    int n_vertices_ = 0, n_faces_ = 0;     ///< active at the current level
+
+public:
+    ProgressiveMesh(){}
+    /// Starts a recording from the current state of "mesh" (its finest level)
+    explicit ProgressiveMesh(const SurfaceMesh& mesh);
+
+    /// Records the collapse of h (moving v1 to "target") before the mesh performs it,
+    /// and applies it; the progressive mesh must be at its coarsest level
+    void record(const SurfaceMesh& mesh, Halfedge h, const Vec3& target);
+
+    size_t n_collapses() const { return collapses_.size(); }
+    size_t level() const { return level_; }
+    int n_vertices() const { return n_vertices_; }
+    int n_faces() const { return n_faces_; }
+
+    /// Moves to the given number of applied collapses (clamped)
+    void set_level(size_t level);
+    /// Moves to the level with (as close as possible to) n vertices
+    void set_n_vertices(int n);
+
+    /// The mesh at the current level (compact indices)
+    void extract(SurfaceMesh& mesh) const;
+
+    /// Binary (de)serialization, of all levels and the current one
+    bool write(const std::string& path) const;
+    /// Fails (leaving this progressive mesh untouched) on truncated or inconsistent data
+    bool read(const std::string& path);
+
+private:
+    void apply(const Collapse& c);
+    void undo(const Collapse& c);
+    /// Are all indices in range and the arrays and counters consistent?
+    bool is_valid() const;
+};
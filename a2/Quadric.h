@@ -1,38 +1,41 @@
 #pragma once
+#include <cmath>
 #include <OpenGP/types.h>
 using namespace OpenGP;
 
 /// This class stores a quadric as a symmetrix 4x4 matrix used by the error quadric mesh decimation algorithms.
+/// Only the 10 unique coefficients are kept (double precision), as the upper triangle, row by row:
+///     | a0 a1 a2 a3 |
+///     |    a4 a5 a6 |      Q(p) = [p 1] Q [p 1]^T
+///     |       a7 a8 |
+///     |          a9 |
 class Quadric {
     typedef Vec3 Normal;
     typedef Vec3 Point;
 public:
     /// Zero constructor
-    Quadric() {}
+    Quadric() { clear(); }
     /// constructs the quadric from the point and normal specifying a plane
     Quadric(const Normal& n, const Point& p) {
-        /// TASK: initialize the quadric given a normal and a point on a supporting plane
-        float a = n(0);
-        float b = n(1);
-        float c = n(2);
-        float d = -(n.dot(p));
-        Q << a*a, a*b, a*c, a*d,
-             a*b, b*b, b*c, b*d,
-             a*c, b*c, c*c, c*d,
-             a*d, b*d, c*d, d*d;
+        double a = n(0);
+        double b = n(1);
+        double c = n(2);
+        double d = -(a*p(0) + b*p(1) + c*p(2));
+        q[0] = a*a; q[1] = a*b; q[2] = a*c; q[3] = a*d;
+                    q[4] = b*b; q[5] = b*c; q[6] = b*d;
+                                q[7] = c*c; q[8] = c*d;
+                                            q[9] = d*d;
     }
 
 
     /// set all matric entries to zero
     void clear() {
-        /// TASK: set the quadric to zero.
-        Q = Eigen::Matrix4f::Zero();
+        for(int i = 0; i < 10; ++i) q[i] = 0;
     }
 
 
     /// add two quadrics
     Quadric operator+( const Quadric& _q ) const {
-        /// TASK: implement quadric add
         Quadric toReturn(*this);
         toReturn += _q;
         return toReturn;
@@ -40,20 +43,39 @@ public:
 
     /// add given quadric to this quadric
     Quadric& operator+=( const Quadric& _q ) {
-        /// TASK: implement quadric (self) add
-        Q = Q + _q.Q;
+        // contiguous, branch-free: vectorized by the compiler
+        for(int i = 0; i < 10; ++i) q[i] += _q.q[i];
         return *this;
     }
 
     // evaluate quadric Q at position p by computing (p^T * Q * p)
     double evaluate(const Point& p) const {
-        /// TASK: evaluate the quadratic form at point p
-        Eigen::Vector4f p_padded(p(0), p(1), p(2), 1);
-        return p_padded.transpose() * Q * p_padded;
+        double x = p(0), y = p(1), z = p(2);
+        return x*(q[0]*x + 2*(q[1]*y + q[2]*z + q[3]))
+             + y*(q[4]*y + 2*(q[5]*z + q[6]))
+             + z*(q[7]*z + 2*q[8])
+             + q[9];
+    }
+
+    /// position minimizing the quadric, i.e. solution of A x = -b for Q = [A b; b^T c];
+    /// false (and x untouched) if A is (close to) singular, e.g. for flat neighborhoods
+    bool minimizer(Point& x) const {
+        // cofactors of the symmetric A
+        double c00 = q[4]*q[7] - q[5]*q[5];
+        double c01 = q[2]*q[5] - q[1]*q[7];
+        double c02 = q[1]*q[5] - q[2]*q[4];
+        double det = q[0]*c00 + q[1]*c01 + q[2]*c02;
+        double scale = q[0] + q[4] + q[7];
+        if(!(std::abs(det) > 1e-8 * scale*scale*scale)) return false;
+        double c11 = q[0]*q[7] - q[2]*q[2];
+        double c12 = q[1]*q[2] - q[0]*q[5];
+        double c22 = q[0]*q[4] - q[1]*q[1];
+        x(0) = -(c00*q[3] + c01*q[6] + c02*q[8]) / det;
+        x(1) = -(c01*q[3] + c11*q[6] + c12*q[8]) / det;
+        x(2) = -(c02*q[3] + c12*q[6] + c22*q[8]) / det;
+        return true;
     }
 
 private:
-    /// TASK: how to store the 4x4 symmetrix matrix?
-    /// hint: see Eigen::SelfAdjointView
-    Eigen::Matrix4f Q;
+    double q[10];
 };
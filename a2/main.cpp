@@ -15,6 +15,7 @@ struct MainWindow : public ArcballWindow{
         if(!success) mFatal() << "File not found: " << argv[1];
         mesh.update_face_normals(); ///< shading
         this->scene.add(renderer);
+        decimator.update_face_normals = true; ///< shading, kept valid by exec()
         decimator.init();
     }
     
@@ -22,7 +23,6 @@ struct MainWindow : public ArcballWindow{
         ArcballWindow::key_callback(key, scancode, action, mods);
         if(key==GLFW_KEY_SPACE && action==GLFW_RELEASE){
             decimator.exec( .9*mesh.n_vertices() );
-            mesh.update_face_normals();
             renderer.init_data();
         }
     }
@@ -0,0 +1,343 @@
+/// Decimation benchmark: throughput, priority queue activity, memory and error.
+///
+///     bench_decimation [meshes...] [-r ratios] [-s levels] [-p placement] [-j] [-o results.csv]
+///
+///   meshes  triangle meshes (bunny.obj fandisk.obj indorelax.obj, deployed next to the binary)
+///   -r  comma separated target ratios of the input vertex count (0.5,0.25,0.1,0.02)
+///   -s  number of Loop subdivisions benchmarked on top of each input (2)
+///   -p  endpoint or optimal, see Decimator::Placement (optimal)
+///   -j  parallel decimation rounds, see Decimator::exec_parallel
+///   -o  machine readable results, one CSV row per run (bench_decimation.csv)
+///
+/// Every (mesh, subdivision level, ratio) is decimated from scratch. A run reports the
+/// init and exec times, collapses per second (exec only), the priority queue operation
+/// counts (with -j, peeks are the candidates visited in place to select each round),
+/// the popped collapses rejected as illegal, the memory of the run, the symmetric Hausdorff distance between the
+/// input and the decimated mesh (sampled at the vertices of both, exact point to
+/// triangle distances) and the max/rms quadric error (root of Decimator::quadric_error);
+/// distances are relative to the bounding box diagonal. The memory of a run is the peak
+/// resident size during the copy of the mesh, init() and exec(), minus the resident size
+/// before (i.e. without the benchmark's own data); it needs Linux (-1 elsewhere).
+#include <OpenGP/MLogger.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <fstream>
+#include <limits>
+#include <algorithm>
+#ifdef __GLIBC__
+    #include <malloc.h>
+#endif
+#include "../Decimator.h"
+
+using namespace OpenGP;
+typedef SurfaceMesh::Vertex Vertex;
+typedef SurfaceMesh::Face Face;
+
+/// Resident memory of the process, in KB, from /proc/self/status (Linux): the current
+/// size ("VmRSS") or its peak ("VmHWM"), -1 if unknown
+long resident_kb(const std::string& field){
+    std::ifstream status("/proc/self/status");
+    for(std::string line; std::getline(status, line);)
+        if(line.compare(0, field.size() + 1, field + ":") == 0)
+            return std::atol(line.c_str() + field.size() + 1);
+    return -1;
+}
+
+/// Starts a memory measurement: returns the memory freed by earlier runs to the system
+/// (glibc, so that reusing it counts again), resets the peak to the current resident
+/// size (Linux) and returns the latter; -1 if not supported
+long begin_memory_kb(){
+#ifdef __GLIBC__
+    malloc_trim(0);
+#endif
+    std::ofstream clear_refs("/proc/self/clear_refs");
+    if(!(clear_refs << "5" << std::flush)) return -1;
+    return resident_kb("VmRSS");
+}
+
+/// Peak resident memory since begin_memory_kb() returned "begin", in KB above it
+long run_memory_kb(long begin){
+    long peak = resident_kb("VmHWM");
+    return (begin < 0 || peak < 0) ? -1 : std::max(0L, peak - begin);
+}
+
+/// Loop subdivision: 1:4 split of every triangle, the vertices smoothed with the Loop
+/// (Warren's) weights and boundaries with the cubic B-spline ones, so that the finer
+/// meshes are curved (midpoint splits would make the new vertices free to collapse)
+void subdivide(const SurfaceMesh& mesh, SurfaceMesh& result){
+    result.clear();
+    result.reserve(mesh.n_vertices() + mesh.n_edges(), 4 * mesh.n_edges(), 4 * mesh.n_faces());
+    for(auto v : mesh.vertices()){
+        Vec3 p = mesh.position(v), sum = Vec3::Zero();
+        int n = 0;
+        if(mesh.is_boundary(v)){
+            for(auto h : mesh.halfedges(v))
+                if(mesh.is_boundary(mesh.edge(h))){ sum += mesh.position(mesh.to_vertex(h)); ++n; }
+            if(n == 2) p = 0.75f * p + 0.125f * sum;
+        }
+        else{
+            for(auto w : mesh.vertices(v)){ sum += mesh.position(w); ++n; }
+            Scalar beta = (n == 3) ? 3.0f / 16 : 3.0f / (8 * n);
+            if(n > 0) p = (1 - n * beta) * p + beta * sum;
+        }
+        result.add_vertex(p);
+    }
+    std::vector<Vertex> midpoint(mesh.edges_size());
+    for(auto e : mesh.edges()){
+        Vec3 p = (mesh.position(mesh.vertex(e, 0)) + mesh.position(mesh.vertex(e, 1))) / 2;
+        if(!mesh.is_boundary(e)){
+            Vec3 opposite = mesh.position(mesh.to_vertex(mesh.next_halfedge(mesh.halfedge(e, 0)))) +
+                            mesh.position(mesh.to_vertex(mesh.next_halfedge(mesh.halfedge(e, 1))));
+            p = 0.75f * p + 0.125f * opposite;
+        }
+        midpoint[e.idx()] = result.add_vertex(p);
+    }
+    for(auto f : mesh.faces()){
+        Vertex corner[3], middle[3];
+        int i = 0;
+        for(auto h : mesh.halfedges(f)){
+            corner[i] = mesh.to_vertex(h); ///< same index in result
+            middle[i] = midpoint[mesh.edge(mesh.next_halfedge(h)).idx()];
+            ++i;
+        }
+        // corner i lies between middle i-1 and middle i
+        for(int k = 0; k < 3; ++k)
+            result.add_triangle(corner[k], middle[k], middle[(k + 2) % 3]);
+        result.add_triangle(middle[0], middle[1], middle[2]);
+    }
+}
+
+/// Closest point queries against the triangles of a mesh, bucketed in a uniform grid
+class TriangleGrid{
+    typedef Eigen::Vector3d Point;
+    std::vector<Point> corners_;        ///< 3 per triangle
+    Point origin_;
+    double h_;
+    Eigen::Vector3i size_;
+    std::vector<int> begin_, triangles_; ///< CSR: triangles of cell c in [begin_[c], begin_[c+1])
+
+public:
+    TriangleGrid(const SurfaceMesh& mesh){
+        Box3 box = bounding_box(mesh);
+        double edges = 0;
+        for(auto e : mesh.edges())
+            edges += (mesh.position(mesh.vertex(e, 1)) - mesh.position(mesh.vertex(e, 0))).norm();
+        // a few triangles per cell, at most 256 cells per axis
+        Point extent = box.diagonal().cast<double>();
+        h_ = std::max(2 * edges / std::max(1, (int) mesh.n_edges()), extent.maxCoeff() / 256);
+        h_ = std::max(h_, 1e-12);
+        origin_ = box.min().cast<double>();
+        size_ = (extent / h_).cast<int>() + Eigen::Vector3i::Ones();
+
+        for(auto f : mesh.faces())
+            for(auto v : mesh.vertices(f))
+                corners_.push_back(mesh.position(v).cast<double>());
+        int n_triangles = (int) corners_.size() / 3;
+        begin_.assign(size_.prod() + 1, 0);
+        for(int pass = 0; pass < 2; ++pass){ ///< count, then fill
+            std::vector<int> cursor;
+            if(pass == 1){
+                for(size_t c = 1; c < begin_.size(); ++c) begin_[c] += begin_[c - 1];
+                triangles_.resize(begin_.back());
+                cursor.assign(begin_.begin(), begin_.end() - 1);
+            }
+            for(int t = 0; t < n_triangles; ++t){
+                Eigen::Vector3i lo = cell(corners_[3*t].cwiseMin(corners_[3*t+1]).cwiseMin(corners_[3*t+2]));
+                Eigen::Vector3i hi = cell(corners_[3*t].cwiseMax(corners_[3*t+1]).cwiseMax(corners_[3*t+2]));
+                for(int i = lo[0]; i <= hi[0]; ++i)
+                    for(int j = lo[1]; j <= hi[1]; ++j)
+                        for(int k = lo[2]; k <= hi[2]; ++k){
+                            int c = index(i, j, k);
+                            if(pass == 0) ++begin_[c + 1];
+                            else triangles_[cursor[c]++] = t;
+                        }
+            }
+        }
+    }
+
+    /// Distance from p to the closest triangle; the cells are visited in rings of
+    /// growing (Chebyshev) radius around that of p, until no closer triangle can remain
+    double distance(const Vec3& point) const{
+        Point p = point.cast<double>();
+        Eigen::Vector3i center = cell(p);
+        double best = std::numeric_limits<double>::infinity();
+        for(int r = 0; r <= size_.maxCoeff(); ++r){
+            Eigen::Vector3i lo = (center.array() - r).max(0);
+            Eigen::Vector3i hi = (center.array() + r).min(size_.array() - 1);
+            for(int i = lo[0]; i <= hi[0]; ++i)
+                for(int j = lo[1]; j <= hi[1]; ++j)
+                    for(int k = lo[2]; k <= hi[2]; ++k){
+                        if(std::max({std::abs(i - center[0]), std::abs(j - center[1]), std::abs(k - center[2])}) != r)
+                            continue; ///< inner rings were visited already
+                        int c = index(i, j, k);
+                        for(int n = begin_[c]; n < begin_[c + 1]; ++n){
+                            int t = triangles_[n];
+                            best = std::min(best, squared_distance(p, corners_[3*t], corners_[3*t+1], corners_[3*t+2]));
+                        }
+                    }
+            // the cells of the next rings are at least r*h away
+            if(best <= (r * h_) * (r * h_)) break;
+        }
+        return std::sqrt(best);
+    }
+
+private:
+    Eigen::Vector3i cell(const Point& p) const{
+        Eigen::Vector3i c = ((p - origin_) / h_).array().floor().cast<int>();
+        return c.cwiseMax(0).cwiseMin(size_ - Eigen::Vector3i::Ones());
+    }
+    int index(int i, int j, int k) const { return (i * size_[1] + j) * size_[2] + k; }
+
+    /// squared distance from p to the triangle abc (Ericson, Real-Time Collision Detection 5.1.5)
+    static double squared_distance(const Point& p, const Point& a, const Point& b, const Point& c){
+        Point ab = b - a, ac = c - a, ap = p - a;
+        double d1 = ab.dot(ap), d2 = ac.dot(ap);
+        if(d1 <= 0 && d2 <= 0) return ap.squaredNorm();
+        Point bp = p - b;
+        double d3 = ab.dot(bp), d4 = ac.dot(bp);
+        if(d3 >= 0 && d4 <= d3) return bp.squaredNorm();
+        double vc = d1 * d4 - d3 * d2;
+        if(vc <= 0 && d1 >= 0 && d3 <= 0) return (ap - (d1 / (d1 - d3)) * ab).squaredNorm();
+        Point cp = p - c;
+        double d5 = ab.dot(cp), d6 = ac.dot(cp);
+        if(d6 >= 0 && d5 <= d6) return cp.squaredNorm();
+        double vb = d5 * d2 - d1 * d6;
+        if(vb <= 0 && d2 >= 0 && d6 <= 0) return (ap - (d2 / (d2 - d6)) * ac).squaredNorm();
+        double va = d3 * d6 - d5 * d4;
+        if(va <= 0 && (d4 - d3) >= 0 && (d5 - d6) >= 0) return (bp - ((d4 - d3) / ((d4 - d3) + (d5 - d6))) * (c - b)).squaredNorm();
+        double denom = 1 / (va + vb + vc);
+        return (ap - ab * (vb * denom) - ac * (vc * denom)).squaredNorm();
+    }
+};
+
+/// max and mean distance from the vertices of "from" to the surface of "to"
+void one_sided_distance(const SurfaceMesh& from, const TriangleGrid& to, double& max, double& mean){
+    auto vpoints = from.get_vertex_property<Vec3>("v:point");
+    int n = (int) from.vertices_size();
+    double max_d = 0, sum_d = 0;
+    #pragma omp parallel for schedule(dynamic, 256) reduction(max:max_d) reduction(+:sum_d)
+    for(int i = 0; i < n; ++i){
+        Vertex v(i);
+        if(from.is_deleted(v)) continue;
+        double d = to.distance(vpoints[v]);
+        max_d = std::max(max_d, d);
+        sum_d += d;
+    }
+    max = max_d;
+    mean = sum_d / std::max(1, (int) from.n_vertices());
+}
+
+int main(int argc, char** argv){
+    std::vector<std::string> inputs;
+    std::vector<double> ratios = {0.5, 0.25, 0.1, 0.02};
+    int levels = 2;
+    Decimator::Placement placement = Decimator::OPTIMAL;
+    bool parallel = false;
+    std::string output = "bench_decimation.csv";
+    for(int a = 1; a < argc; ++a){
+        std::string option = argv[a];
+        if(option[0] != '-'){ inputs.push_back(option); continue; }
+        if(option == "-j"){ parallel = true; continue; }
+        if(a + 1 == argc) mFatal() << "Missing value of " << option;
+        std::string value = argv[++a];
+        if(option == "-r"){
+            ratios.clear();
+            std::stringstream list(value);
+            for(std::string ratio; std::getline(list, ratio, ',');)
+                ratios.push_back(std::atof(ratio.c_str()));
+        }
+        else if(option == "-s") levels = std::atoi(value.c_str());
+        else if(option == "-p"){
+            if(value == "endpoint") placement = Decimator::ENDPOINT;
+            else if(value == "optimal") placement = Decimator::OPTIMAL;
+            else mFatal() << "Unknown placement: " << value;
+        }
+        else if(option == "-o") output = value;
+        else mFatal() << "Unknown option: " << option;
+    }
+    if(inputs.empty()) inputs = {"bunny.obj", "fandisk.obj", "indorelax.obj"};
+
+    std::ofstream csv(output);
+    if(!csv) mFatal() << "Cannot write " << output;
+    csv << "mesh,subdivisions,vertices,faces,ratio,target,placement,parallel,final_vertices,collapses,"
+           "init_s,exec_s,collapses_per_s,pq_inserts,pq_updates,pq_removes,pq_pops,pq_peeks,illegal_pops,"
+           "run_memory_kb,hausdorff,mean_distance,quadric_max,quadric_rms\n";
+
+    typedef std::chrono::steady_clock Clock;
+    auto elapsed = [](Clock::time_point since){ return std::chrono::duration<double>(Clock::now() - since).count(); };
+    std::vector<std::string> summary;
+    for(const std::string& input : inputs){
+        SurfaceMesh mesh;
+        if(!mesh.read(input)) mFatal() << "File not found: " << input;
+        if(!mesh.is_triangle_mesh()) mFatal() << "The decimation needs a triangle mesh: " << input;
+        for(int level = 0; level <= levels; ++level){
+            if(level > 0){
+                SurfaceMesh finer;
+                subdivide(mesh, finer);
+                mesh = finer;
+            }
+            Scalar diagonal = bounding_box(mesh).diagonal().norm();
+            TriangleGrid mesh_grid(mesh);
+            for(double ratio : ratios){
+                int target = std::max(4, int(ratio * mesh.n_vertices()));
+                long memory_begin = begin_memory_kb();
+                SurfaceMesh decimated = mesh;
+                Clock::time_point start = Clock::now();
+                Decimator decimator(decimated, placement);
+                decimator.init();
+                double init_time = elapsed(start);
+                start = Clock::now();
+                if(parallel) decimator.exec_parallel(target);
+                else decimator.exec(target);
+                double exec_time = elapsed(start);
+                long memory = run_memory_kb(memory_begin); ///< before the error evaluation
+
+                int collapses = (int) (mesh.n_vertices() - decimated.n_vertices());
+                PriorityQueue::Stats queue = decimator.queue_stats();
+                long illegal = (long) decimator.n_illegal_collapses();
+                Scalar quadric_max = 0, quadric_sum = 0;
+                for(auto v : decimated.vertices()){
+                    Scalar error = std::max(Scalar(0), decimator.quadric_error(v));
+                    quadric_max = std::max(quadric_max, error);
+                    quadric_sum += error;
+                }
+                double hausdorff, mean_distance, to_max, to_mean;
+                one_sided_distance(decimated, mesh_grid, to_max, to_mean);
+                one_sided_distance(mesh, TriangleGrid(decimated), hausdorff, mean_distance);
+                hausdorff = std::max(hausdorff, to_max);
+
+                std::stringstream row;
+                row << input << "," << level << "," << mesh.n_vertices() << "," << mesh.n_faces() << ","
+                    << ratio << "," << target << "," << (placement == Decimator::OPTIMAL ? "optimal" : "endpoint") << ","
+                    << parallel << "," << decimated.n_vertices() << "," << collapses << ","
+                    << init_time << "," << exec_time << "," << collapses / std::max(exec_time, 1e-9) << ","
+                    << queue.inserts << "," << queue.updates << "," << queue.removes << "," << queue.pops << "," << queue.peeks << ","
+                    << illegal << "," << memory << ","
+                    << hausdorff / diagonal << "," << mean_distance / diagonal << ","
+                    << std::sqrt(quadric_max) / diagonal << "," << std::sqrt(quadric_sum / decimated.n_vertices()) / diagonal;
+                csv << row.str() << std::endl;
+
+                char line[256];
+                std::snprintf(line, sizeof(line), "%-16s %2d %8d %6.3f %8d %10.0f %11.3e %11.3e %9ld",
+                              input.c_str(), level, (int) mesh.n_vertices(), ratio, (int) decimated.n_vertices(),
+                              collapses / std::max(exec_time, 1e-9), hausdorff / diagonal,
+                              std::sqrt(quadric_max) / diagonal, memory);
+                summary.push_back(line);
+            }
+        }
+    }
+
+    std::printf("%-16s %2s %8s %6s %8s %10s %11s %11s %9s\n", "mesh", "s", "#V", "ratio", "#V out",
+                "collapse/s", "hausdorff", "quadric", "run KB");
+    for(const std::string& line : summary)
+        std::printf("%s\n", line.c_str());
+    std::printf("Results written to %s\n", output.c_str());
+    return 0;
+}
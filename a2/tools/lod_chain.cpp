@@ -0,0 +1,106 @@
+/// Headless batch decimation into a chain of levels of detail.
+///
+///     lod_chain input.obj output_prefix [-n counts] [-l levels] [-p placement] [-j] [-m]
+///
+///   -n  comma separated target vertex counts, e.g. 20000,5000,1000 (any order)
+///   -l  number of levels when -n is not given, each with half the vertices of the previous (5)
+///   -p  endpoint or optimal, see Decimator::Placement (optimal)
+///   -j  parallel decimation rounds, see Decimator::exec_parallel
+///   -m  also write the progressive mesh (output_prefix.pm), see ProgressiveMesh
+///
+/// The mesh is decimated once, from the finest to the coarsest target; a snapshot of
+/// each level is written to output_prefix_lod<i>.obj (lod0 being the finest target).
+/// Each level reports the decimation time since the previous one and its quadric
+/// error, i.e. the distance from its vertices to the planes of the input faces merged
+/// into them (root of Decimator::quadric_error), relative to the bounding box diagonal.
+#include <OpenGP/MLogger.h>
+#include <OpenGP/SurfaceMesh/SurfaceMesh.h>
+#include <OpenGP/SurfaceMesh/bounding_box.h>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <functional>
+#include "../Decimator.h"
+#include "../ProgressiveMesh.h"
+
+using namespace OpenGP;
+
+int main(int argc, char** argv){
+    if(argc < 3) mFatal("usage: lod_chain input.obj output_prefix [-n counts] [-l levels] [-p placement] [-j] [-m]");
+    std::string input = argv[1], prefix = argv[2];
+    std::vector<int> targets;
+    int levels = 5;
+    Decimator::Placement placement = Decimator::OPTIMAL;
+    bool parallel = false, write_progressive = false;
+    for(int a = 3; a < argc; ++a){
+        std::string option = argv[a];
+        if(option == "-j"){ parallel = true; continue; }
+        if(option == "-m"){ write_progressive = true; continue; }
+        if(a + 1 == argc) mFatal() << "Missing value of " << option;
+        std::string value = argv[++a];
+        if(option == "-n"){
+            std::stringstream list(value);
+            for(std::string count; std::getline(list, count, ',');)
+                targets.push_back(std::atoi(count.c_str()));
+        }
+        else if(option == "-l") levels = std::atoi(value.c_str());
+        else if(option == "-p"){
+            if(value == "endpoint") placement = Decimator::ENDPOINT;
+            else if(value == "optimal") placement = Decimator::OPTIMAL;
+            else mFatal() << "Unknown placement: " << value;
+        }
+        else mFatal() << "Unknown option: " << option;
+    }
+
+    SurfaceMesh mesh;
+    if(!mesh.read(input)) mFatal() << "File not found: " << input;
+    if(!mesh.is_triangle_mesh()) mFatal() << "The decimation needs a triangle mesh: " << input;
+    if(targets.empty())
+        for(int i = 1; i <= levels; ++i)
+            targets.push_back(std::max(4, int(mesh.n_vertices() >> i)));
+    std::sort(targets.begin(), targets.end(), std::greater<int>());
+    Scalar diagonal = bounding_box(mesh).diagonal().norm();
+
+    typedef std::chrono::steady_clock Clock;
+    auto elapsed = [](Clock::time_point since){ return std::chrono::duration<double>(Clock::now() - since).count(); };
+    Clock::time_point start = Clock::now();
+    ProgressiveMesh progressive(mesh);
+    Decimator decimator(mesh, placement);
+    decimator.progressive = &progressive;
+    decimator.init();
+    std::printf("%s: %d vertices, %d faces, init %.3fs\n", input.c_str(), (int) mesh.n_vertices(), (int) mesh.n_faces(), elapsed(start));
+    std::printf("%5s %9s %9s %9s %9s %12s %12s\n", "level", "target", "#V", "#F", "time(s)", "max error", "rms error");
+
+    for(size_t i = 0; i < targets.size(); ++i){
+        start = Clock::now();
+        if(parallel) decimator.exec_parallel(targets[i]);
+        else decimator.exec(targets[i]);
+        double time = elapsed(start);
+
+        Scalar max_error = 0, sum_error = 0;
+        for(auto v : mesh.vertices()){
+            Scalar error = std::max(Scalar(0), decimator.quadric_error(v));
+            max_error = std::max(max_error, error);
+            sum_error += error;
+        }
+        std::printf("%5d %9d %9d %9d %9.3f %12.3e %12.3e\n", (int) i, targets[i], (int) mesh.n_vertices(), (int) mesh.n_faces(),
+                    time, std::sqrt(max_error) / diagonal, std::sqrt(sum_error / mesh.n_vertices()) / diagonal);
+
+        // the progressive mesh is at the current level: a compact copy of the decimated mesh
+        SurfaceMesh level;
+        progressive.extract(level);
+        std::string path = prefix + "_lod" + std::to_string(i) + ".obj";
+        if(!level.write(path)) mFatal() << "Cannot write " << path;
+        if(mesh.n_vertices() > (unsigned int) targets[i])
+            mDebug() << "Stopped at" << mesh.n_vertices() << "vertices, no legal collapse left";
+    }
+
+    if(write_progressive && !progressive.write(prefix + ".pm"))
+        mFatal() << "Cannot write " << prefix + ".pm";
+    return 0;
+}
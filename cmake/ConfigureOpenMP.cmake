@@ -0,0 +1,6 @@
+#--- Parallel loops (optional, code falls back to serial execution)
+find_package(OpenMP)
+if(OPENMP_FOUND)
+    set(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} ${OpenMP_CXX_FLAGS}")
+    list(APPEND LIBRARIES ${OpenMP_CXX_LIBRARIES})
+endif()
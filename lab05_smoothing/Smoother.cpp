@@ -1,4 +1,5 @@
 #include "Smoother.h"
+#include <OpenGP/MLogger.h>
 
 using namespace Eigen;
 using namespace OpenGP;
@@ -14,6 +15,12 @@ void Smoother::init()
 {
     int n = mesh.n_vertices();
     L = SparseMatrix<Scalar>(n, n);
+    S = SparseMatrix<Scalar>(n, n);
+    mass = VectorXf::Ones(n);
+
+    // (the connectivity may have changed)
+    analyzed_nonzeros = -1;
+    factorized_lambda = std::numeric_limits<Scalar>::quiet_NaN();
 }
 
 void Smoother::use_cotan_laplacian()
@@ -96,6 +103,9 @@ void Smoother::use_cotan_laplacian()
     D.setFromTriplets(diagonalList.begin(), diagonalList.end());
 
     L = D * M;
+    S = M;
+    mass = D.diagonal();
+    factorized_lambda = std::numeric_limits<Scalar>::quiet_NaN();
 }
 
 void Smoother::use_graph_laplacian()
@@ -128,6 +138,9 @@ void Smoother::use_graph_laplacian()
     }
 
     L.setFromTriplets(laplacianList.begin(), laplacianList.end());
+    S = L;
+    mass = VectorXf::Ones(n);
+    factorized_lambda = std::numeric_limits<Scalar>::quiet_NaN();
 }
 
 void Smoother::smooth_explicit(OpenGP::Scalar lambda)
@@ -165,27 +178,36 @@ void Smoother::smooth_explicit(OpenGP::Scalar lambda)
 
 void Smoother::smooth_implicit(OpenGP::Scalar lambda)
 {
-    int n = mesh.n_vertices();
-    SparseMatrix<Scalar> I(n, n);
-    I.setIdentity();
-
-    MatrixXf P_t(3, mesh.n_vertices());
-    MatrixXf P_t1(3, mesh.n_vertices());
+    MatrixXf P_t(mesh.n_vertices(), 3);
 
     int i = 0;
     for (auto const& vertex : mesh.vertices())
     {
-        Point p = mesh.position(vertex);
-        P_t.col(i) = p;
+        P_t.row(i) = mesh.position(vertex);
         ++i;
     }
 
-    P_t.transposeInPlace();
-    P_t1.transposeInPlace();
-
-    SparseMatrix<Scalar> A = (I - lambda * L);
-    solve_linear_least_square(A, P_t, P_t1);
-    P_t = P_t1;
+    // Solve for the three coordinates at once. The fixed vertices keep their
+    // positions, their columns move to the right-hand side.
+    if (!factorize(lambda))
+    {
+        mWarning() << "Smoother: cannot factorize the implicit system, lambda =" << lambda;
+        return;
+    }
+    MatrixXf B(P_t.rows(), 3);
+    for (int j = 0; j < B.rows(); ++j)
+        B.row(j) = P_t.row(j) / (is_fixed(j) ? 1.0f : mass(j));
+    for (int k = 0; k < S.outerSize(); ++k)
+        if (is_fixed(k))
+            for (SparseMatrix<Scalar>::InnerIterator it(S, k); it; ++it)
+                if (!is_fixed(it.row()))
+                    B.row(it.row()) += lambda * it.value() * P_t.row(k);
+    MatrixXf P_t1 = solver.solve(B);
+    if (solver.info() != Eigen::Success || !P_t1.allFinite())
+    {
+        mWarning() << "Smoother: the implicit solve failed, lambda =" << lambda;
+        return;
+    }
 
     // Now assign the points back into the mesh.
     i = 0;
@@ -196,17 +218,34 @@ void Smoother::smooth_implicit(OpenGP::Scalar lambda)
     }
 }
 
-void Smoother::solve_linear_least_square(Eigen::SparseMatrix<OpenGP::Scalar>& A, Eigen::MatrixXf&B, Eigen::MatrixXf& X)
+bool Smoother::factorize(OpenGP::Scalar lambda)
 {
-    SparseMatrix<Scalar> At = A.transpose();
-    SparseMatrix<Scalar> AtA = At * A;
-
-    typedef SimplicialLDLT<SparseMatrix<Scalar>> Solver;
-    Solver solver;
-    solver.compute(AtA);
+    if (lambda == factorized_lambda)
+        return true;
+
+    // A = diag(mass)^-1 - lambda * S, the diagonal of S is stored explicitly;
+    // the rows and columns of the fixed vertices are those of the identity (zeroed,
+    // not pruned, so that the pattern stays that of S).
+    SparseMatrix<Scalar> A = -lambda * S;
+    for (int k = 0; k < A.outerSize(); ++k)
+        for (SparseMatrix<Scalar>::InnerIterator it(A, k); it; ++it)
+            if (it.row() != k && (is_fixed(k) || is_fixed(it.row())))
+                it.valueRef() = 0;
+    for (int i = 0; i < A.rows(); ++i)
+    {
+        if (is_fixed(i)) A.coeffRef(i, i) = 1.0f;
+        else A.coeffRef(i, i) += 1.0f / mass(i);
+    }
 
-    for (int i = 0; i < B.cols(); ++i)
+    // The Laplacians share the pattern of the connectivity: analyze it once.
+    if (A.nonZeros() != analyzed_nonzeros)
     {
-        X.col(i) = solver.solve(At * B.col(i));
+        solver.analyzePattern(A);
+        analyzed_nonzeros = A.nonZeros();
     }
+    solver.factorize(A);
+    if (solver.info() != Eigen::Success)
+        return false;
+    factorized_lambda = lambda;
+    return true;
 }
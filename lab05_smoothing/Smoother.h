@@ -2,6 +2,8 @@
 
 #include <OpenGP/SurfaceMesh/SurfaceMesh.h>
 #include <Eigen/Sparse>
+#include <limits>
+#include <cmath>
 
 class Smoother
 {
@@ -18,9 +20,22 @@ public:
     void smooth_implicit(OpenGP::Scalar lambda);
 
 private:
-    void solve_linear_least_square(Eigen::SparseMatrix<OpenGP::Scalar>& A, Eigen::MatrixXf& B, Eigen::MatrixXf& X);
+    /// Factorizes the system of smooth_implicit(lambda), false on failure
+    bool factorize(OpenGP::Scalar lambda);
+    /// Vertices without (valid) area have a zero row in L, i.e. stay in place: they are
+    /// eliminated from the symmetric system (identity row and column)
+    bool is_fixed(int i) const { return !(mass(i) > 0) || !std::isfinite(mass(i)); }
 
     OpenGP::SurfaceMesh& mesh;
-    Eigen::SparseMatrix<OpenGP::Scalar> L;
-
+    Eigen::SparseMatrix<OpenGP::Scalar> L;  ///< L = diag(mass) * S
+    Eigen::SparseMatrix<OpenGP::Scalar> S;  ///< symmetric
+    Eigen::VectorXf mass;
+
+    /// Implicit smoothing solves (I - lambda * L) X = P as the equivalent symmetric
+    /// system (diag(mass)^-1 - lambda * S) X = diag(mass)^-1 P. Its symbolic analysis
+    /// is kept until init() (i.e. while the connectivity is unchanged), its numeric
+    /// factorization while neither lambda nor the Laplacian change.
+    Eigen::SimplicialLDLT<Eigen::SparseMatrix<OpenGP::Scalar>> solver;
+    Eigen::Index analyzed_nonzeros = -1;    ///< -1: no symbolic analysis
+    OpenGP::Scalar factorized_lambda = std::numeric_limits<OpenGP::Scalar>::quiet_NaN(); ///< NaN: no factorization
 };
\ No newline at end of file